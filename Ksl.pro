@@ -8,16 +8,35 @@ INCLUDEPATH += .
 
 # Input
 HEADERS += src/Core/Ksl/Array.h \
+           src/Core/Ksl/Bfs.h \
+           src/Core/Ksl/Bfs_p.h \
            src/Core/Ksl/Csv.h \
            src/Core/Ksl/Csv_p.h \
+           src/Core/Ksl/CsvLoader.h \
+           src/Core/Ksl/CsvLoader_p.h \
+           src/Core/Ksl/CsvReader.h \
+           src/Core/Ksl/CsvReader_p.h \
+           src/Core/Ksl/CsvWriter.h \
+           src/Core/Ksl/CsvWriter_p.h \
            src/Core/Ksl/Functions.h \
            src/Core/Ksl/Global.h \
            src/Core/Ksl/Graph.h \
+           src/Core/Ksl/GraphBuilder.h \
+           src/Core/Ksl/GraphBuilder_p.h \
+           src/Core/Ksl/GroupBy.h \
+           src/Core/Ksl/GroupBy_p.h \
            src/Core/Ksl/Math.h \
            src/Core/Ksl/MemoryPool.h \
            src/Core/Ksl/MemoryPool_p.h \
+           src/Core/Ksl/NumberFormat.h \
+           src/Core/Ksl/NumberParser_p.h \
            src/Core/Ksl/Object.h \
            src/Core/Ksl/Object_p.h \
+           src/Core/Ksl/PoolAllocator.h \
+           src/Core/Ksl/ShortestPath.h \
+           src/Core/Ksl/ShortestPath_p.h \
+           src/Core/Ksl/Table.h \
+           src/Core/Ksl/Vec.h \
            src/Plotting/Ksl/BasePlot.h \
            src/Plotting/Ksl/BasePlot_p.h \
            src/Plotting/Ksl/CanvasWindow.h \
@@ -55,13 +74,30 @@ HEADERS += src/Core/Ksl/Array.h \
            src/Regression/Ksl/LineRegr.h \
            src/Regression/Ksl/LineRegr_p.h \
            src/Regression/Ksl/MultiLineRegr.h \
-           src/Regression/Ksl/MultiLineRegr_p.h
-SOURCES += tests/chart.cpp \
+           src/Regression/Ksl/MultiLineRegr_p.h \
+           tests/bench.h
+SOURCES += tests/bfs.cpp \
+           tests/chart.cpp \
+           tests/csv.cpp \
            tests/devtest.cpp \
+           tests/groupby.cpp \
+           tests/mempool.cpp \
+           tests/mempoolmt.cpp \
            tests/multifit.cpp \
+           tests/poolalloc.cpp \
+           tests/shortestpath.cpp \
+           src/Core/Ksl/Bfs.cpp \
            src/Core/Ksl/Csv.cpp \
+           src/Core/Ksl/CsvLoader.cpp \
+           src/Core/Ksl/CsvReader.cpp \
+           src/Core/Ksl/CsvWriter.cpp \
            src/Core/Ksl/Global.cpp \
+           src/Core/Ksl/GraphBuilder.cpp \
+           src/Core/Ksl/GroupBy.cpp \
            src/Core/Ksl/MemoryPool.cpp \
+           src/Core/Ksl/NumberFormat.cpp \
+           src/Core/Ksl/ShortestPath.cpp \
+           src/Core/Ksl/Table.cpp \
            src/Plotting/Ksl/BasePlot.cpp \
            src/Plotting/Ksl/CanvasWindow.cpp \
            src/Plotting/Ksl/Chart.cpp \
@@ -246,6 +246,7 @@ public:
     void append(const Tp &value);
     void push(const Tp &value);
     void pop();
+    void reserve(int size);
 
 private:
     
@@ -368,6 +369,15 @@ void Array<1,Tp>::push(const Tp &value) {
 }
 
 
+template <typename Tp>
+void Array<1,Tp>::reserve(int size) {
+    if (!m_data) {
+        m_data = new Array<0,Tp>(0,0);
+    }
+    m_data->reserve(size);
+}
+
+
 template <typename Tp>
 void Array<1,Tp>::pop() {
     if (m_data) {
@@ -480,6 +490,8 @@ public:
     Array<0,Tp>* storage() { return m_data; }
     const Array<0,Tp>* storage() const { return m_data; }
 
+    void resize(int rows, int cols);
+
 
 private:
     
@@ -573,6 +585,16 @@ Array<2,Tp>::operator= (Array<2,Tp> &&that) {
 }
 
 
+template <typename Tp>
+void Array<2,Tp>::resize(int rows, int cols) {
+    if (!m_data) {
+        m_data = new Array<0,Tp>(rows, cols);
+    } else {
+        m_data->resize(rows, cols);
+    }
+}
+
+
 template <typename Tp> inline std::ostream&
 operator<< (std::ostream &out, const Array<2,Tp> &array) {
     int m = array.rows();
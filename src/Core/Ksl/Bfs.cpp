@@ -0,0 +1,329 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Ksl/Bfs_p.h>
+#include <QList>
+#include <QThread>
+#include <QtConcurrentRun>
+#include <limits>
+
+namespace Ksl {
+
+Bfs::Bfs()
+    : Ksl::Object(new BfsPrivate(this))
+{ }
+
+
+void Bfs::setParallel(bool parallel) {
+    KSL_PUBLIC(Bfs);
+    m->parallel = parallel;
+}
+
+
+bool Bfs::parallel() const {
+    KSL_PUBLIC(const Bfs);
+    return m->parallel;
+}
+
+
+void Bfs::setSymmetric(bool symmetric) {
+    KSL_PUBLIC(Bfs);
+    m->symmetric = symmetric;
+    m->inOffsetsOf = nullptr;
+    m->inTargetsOf = nullptr;
+    m->inOffsets = std::vector<uint64_t>();
+    m->inSources = std::vector<uint32_t>();
+}
+
+
+bool Bfs::symmetric() const {
+    KSL_PUBLIC(const Bfs);
+    return m->symmetric;
+}
+
+
+void Bfs::setAlpha(double alpha) {
+    KSL_PUBLIC(Bfs);
+    m->alpha = alpha;
+}
+
+
+double Bfs::alpha() const {
+    KSL_PUBLIC(const Bfs);
+    return m->alpha;
+}
+
+
+void Bfs::setBeta(double beta) {
+    KSL_PUBLIC(Bfs);
+    m->beta = beta;
+}
+
+
+double Bfs::beta() const {
+    KSL_PUBLIC(const Bfs);
+    return m->beta;
+}
+
+
+Array<1,int> Bfs::distances() const {
+    KSL_PUBLIC(const Bfs);
+    return m->distances;
+}
+
+
+Array<1,int> Bfs::parents() const {
+    KSL_PUBLIC(const Bfs);
+    return m->parents;
+}
+
+
+int Bfs::depth() const {
+    KSL_PUBLIC(const Bfs);
+    return m->depth;
+}
+
+
+int Bfs::bottomUpSteps() const {
+    KSL_PUBLIC(const Bfs);
+    return m->bottomUpSteps;
+}
+
+
+bool Bfs::run(uint32_t vertexCount, const uint64_t *offsets,
+              const uint32_t *targets, uint32_t source)
+{
+    KSL_PUBLIC(Bfs);
+    m->depth = 0;
+    m->bottomUpSteps = 0;
+    m->distances = Array<1,int>();
+    m->parents = Array<1,int>();
+    if (source >= vertexCount || vertexCount > uint32_t(std::numeric_limits<int>::max()))
+        return false;
+
+    const uint32_t count = vertexCount;
+    const uint64_t edgeCount = offsets[count];
+    const bool bottomUpAllowed = m->alpha > 0.0;
+    if (bottomUpAllowed && !m->symmetric)
+        m->transpose(count, offsets, targets);
+
+    m->distances = Array<1,int>(int(count), -1);
+    std::vector< std::atomic<int> > parents(count);
+    for (auto &parent : parents)
+        parent.store(-1, std::memory_order_relaxed);
+
+    BfsPrivate::Search search;
+    search.count = count;
+    search.offsets = offsets;
+    search.targets = targets;
+    search.inOffsets = m->symmetric ? offsets : m->inOffsets.data();
+    search.inSources = m->symmetric ? targets : m->inSources.data();
+    search.parents = parents.data();
+    search.distances = m->distances.begin();
+    search.depth = 0;
+
+    parents[source].store(int(source), std::memory_order_relaxed);
+    search.distances[source] = 0;
+
+    // The frontier is a list of vertices when going top-down
+    // and a bitmap when going bottom-up
+    const uint32_t words = (count + 63) / 64;
+    std::vector<uint32_t> queue(1, source);
+    std::vector<uint64_t> frontier, next;
+    bool bottomUp = false;
+    uint32_t frontierSize = 1;
+    uint64_t frontierEdges = offsets[source+1] - offsets[source];
+    uint64_t unvisitedEdges = edgeCount - frontierEdges;
+    uint32_t previousSize = 0;
+
+    while (frontierSize > 0) {
+        const uint32_t lastSize = frontierSize;
+        if (!bottomUp && bottomUpAllowed
+                && double(frontierEdges) > double(unvisitedEdges) / m->alpha) {
+            bottomUp = true;
+            frontier.assign(words, 0);
+            for (uint32_t vertex : queue)
+                frontier[vertex / 64] |= uint64_t(1) << (vertex % 64);
+        }
+        else if (bottomUp && frontierSize < previousSize
+                 && double(frontierSize) < double(count) / m->beta) {
+            bottomUp = false;
+            queue.clear();
+            for (uint32_t w=0; w<words; ++w) {
+                for (uint64_t bits=frontier[w]; bits!=0; bits&=bits-1)
+                    queue.push_back(w*64 + uint32_t(__builtin_ctzll(bits)));
+            }
+        }
+
+        QList<BfsPrivate::Part> parts;
+        if (bottomUp) {
+            // threads take whole words of the bitmaps
+            next.assign(words, 0);
+            const int threads = m->threads(count);
+            if (threads == 1) {
+                parts.append(BfsPrivate::bottomUp(&search, frontier.data(),
+                                                  next.data(), 0, count));
+            }
+            else {
+                QList< QFuture<BfsPrivate::Part> > futures;
+                for (int k=0; k<threads; ++k) {
+                    uint32_t begin = uint32_t(uint64_t(words) * k / threads) * 64;
+                    uint32_t end = qMin(uint32_t(uint64_t(words) * (k+1) / threads) * 64, count);
+                    futures.append(QtConcurrent::run(&BfsPrivate::bottomUp, &search,
+                                                     (const uint64_t*) frontier.data(),
+                                                     next.data(), begin, end));
+                }
+                for (auto &future : futures)
+                    parts.append(future.result());
+            }
+            frontier.swap(next);
+            m->bottomUpSteps += 1;
+        }
+        else {
+            const int threads = m->threads(uint32_t(queue.size()));
+            const uint32_t *first = queue.data();
+            if (threads == 1) {
+                parts.append(BfsPrivate::topDown(&search, first, first + queue.size()));
+            }
+            else {
+                QList< QFuture<BfsPrivate::Part> > futures;
+                for (int k=0; k<threads; ++k) {
+                    size_t begin = queue.size() * k / threads;
+                    size_t end = queue.size() * (k+1) / threads;
+                    futures.append(QtConcurrent::run(&BfsPrivate::topDown, &search,
+                                                     first + begin, first + end));
+                }
+                for (auto &future : futures)
+                    parts.append(future.result());
+            }
+            queue.clear();
+            for (auto &part : parts)
+                queue.insert(queue.end(), part.next.begin(), part.next.end());
+        }
+
+        frontierSize = 0;
+        frontierEdges = 0;
+        for (auto &part : parts) {
+            frontierSize += part.found;
+            frontierEdges += part.edges;
+        }
+        unvisitedEdges -= qMin(unvisitedEdges, frontierEdges);
+        search.depth += 1;
+
+        previousSize = lastSize;
+    }
+
+    m->depth = search.depth;
+    m->parents = Array<1,int>(int(count));
+    int *out = m->parents.begin();
+    for (uint32_t k=0; k<count; ++k)
+        out[k] = parents[k].load(std::memory_order_relaxed);
+    return true;
+}
+
+
+int BfsPrivate::threads(uint32_t work) const {
+    if (!parallel)
+        return 1;
+    return int(qMin(uint32_t(qMax(QThread::idealThreadCount(), 1)),
+                    qMax(work / MinThreadVertices, uint32_t(1))));
+}
+
+
+BfsPrivate::Part BfsPrivate::topDown(const Search *search, const uint32_t *begin,
+                                     const uint32_t *end)
+{
+    Part ret;
+    const int depth = search->depth + 1;
+    for (const uint32_t *vertex=begin; vertex<end; ++vertex) {
+        const uint64_t last = search->offsets[*vertex+1];
+        for (uint64_t e=search->offsets[*vertex]; e<last; ++e) {
+            const uint32_t target = search->targets[e];
+            // cheap check before claiming the vertex
+            int parent = search->parents[target].load(std::memory_order_relaxed);
+            if (parent != -1)
+                continue;
+            if (!search->parents[target].compare_exchange_strong(
+                    parent, int(*vertex), std::memory_order_relaxed))
+                continue;
+            search->distances[target] = depth;
+            ret.next.push_back(target);
+            ret.edges += search->offsets[target+1] - search->offsets[target];
+        }
+    }
+    ret.found = uint32_t(ret.next.size());
+    return std::move(ret);
+}
+
+
+BfsPrivate::Part BfsPrivate::bottomUp(const Search *search, const uint64_t *frontier,
+                                      uint64_t *next, uint32_t begin, uint32_t end)
+{
+    Part ret;
+    const int depth = search->depth + 1;
+    for (uint32_t vertex=begin; vertex<end; ++vertex) {
+        if (search->parents[vertex].load(std::memory_order_relaxed) != -1)
+            continue;
+        // the first parent found in the frontier will do
+        const uint64_t last = search->inOffsets[vertex+1];
+        for (uint64_t e=search->inOffsets[vertex]; e<last; ++e) {
+            const uint32_t source = search->inSources[e];
+            if (frontier[source / 64] & (uint64_t(1) << (source % 64))) {
+                search->parents[vertex].store(int(source), std::memory_order_relaxed);
+                search->distances[vertex] = depth;
+                next[vertex / 64] |= uint64_t(1) << (vertex % 64);
+                ret.found += 1;
+                ret.edges += search->offsets[vertex+1] - search->offsets[vertex];
+                break;
+            }
+        }
+    }
+    return std::move(ret);
+}
+
+
+void BfsPrivate::transpose(uint32_t count, const uint64_t *offsets,
+                           const uint32_t *targets)
+{
+    const uint64_t edgeCount = offsets[count];
+    if (offsets == inOffsetsOf && targets == inTargetsOf
+        && count == inCount && edgeCount == inEdgeCount)
+        return;
+    inOffsetsOf = offsets;
+    inTargetsOf = targets;
+    inCount = count;
+    inEdgeCount = edgeCount;
+
+    // counting sort of the edges by target
+    inOffsets.assign(count + 1, 0);
+    for (uint64_t e=0; e<edgeCount; ++e)
+        inOffsets[targets[e] + 1] += 1;
+    for (uint32_t v=0; v<count; ++v)
+        inOffsets[v+1] += inOffsets[v];
+
+    inSources.resize(edgeCount);
+    std::vector<uint64_t> pos(inOffsets.begin(), inOffsets.end() - 1);
+    for (uint32_t v=0; v<count; ++v) {
+        for (uint64_t e=offsets[v]; e<offsets[v+1]; ++e)
+            inSources[pos[targets[e]]++] = v;
+    }
+}
+
+} // namespace Ksl
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KSL_BFS_H
+#define KSL_BFS_H
+
+#include <Ksl/Array.h>
+#include <Ksl/Graph.h>
+#include <Ksl/Object.h>
+
+namespace Ksl {
+
+// Breadth-first search over a graph in compressed sparse row
+// layout. Each level is expanded top-down, from the vertices of
+// the frontier, or bottom-up, with the unvisited vertices looking
+// for a parent in a bitmap of the frontier, whichever checks
+// fewer edges (direction-optimising search)
+class KSL_EXPORT Bfs
+    : public Ksl::Object
+{
+public:
+
+    Bfs();
+
+
+    // When set, each level is split among all cores
+    void setParallel(bool parallel);
+
+    bool parallel() const;
+
+    // Tells that every edge is also stored in the opposite
+    // direction. Otherwise bottom-up steps need a transposed
+    // copy of the graph, built by run() and kept while the same
+    // arrays are searched. Setting it drops the copy, which must
+    // be done when the arrays are changed in place
+    void setSymmetric(bool symmetric);
+
+    bool symmetric() const;
+
+    // Search goes bottom-up when the edges out of the frontier
+    // are more than 1/alpha of the edges out of the unvisited
+    // vertices, and back top-down when the frontier shrinks below
+    // 1/beta of the vertices. A zero alpha turns bottom-up off
+    void setAlpha(double alpha);
+
+    double alpha() const;
+
+    void setBeta(double beta);
+
+    double beta() const;
+
+
+    template <typename VertData, typename EdgeData>
+    bool run(const FrozenGraph<VertData,EdgeData> &graph, uint32_t source) {
+        return run(graph.vertexCount(), graph.offsets(), graph.targets(), source);
+    }
+
+    // The edges of vertex v go to targets[offsets[v]] up to
+    // targets[offsets[v+1]]. Fails if source is not a vertex
+    bool run(uint32_t vertexCount, const uint64_t *offsets,
+             const uint32_t *targets, uint32_t source);
+
+
+    // Edges from the source to each vertex, -1 if not reached
+    Array<1,int> distances() const;
+
+    // The vertex each one was reached from, -1 if not reached.
+    // The source is its own parent
+    Array<1,int> parents() const;
+
+    // Levels of the last search, and how many of them went
+    // bottom-up
+    int depth() const;
+
+    int bottomUpSteps() const;
+};
+
+} // namespace Ksl
+
+#endif // KSL_BFS_H
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the public Ksl API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed. Do not include it
+//
+// We mean it.
+//
+
+#ifndef KSL_BFS_P_H
+#define KSL_BFS_P_H
+
+#include <Ksl/Bfs.h>
+#include <atomic>
+#include <vector>
+
+namespace Ksl {
+
+class BfsPrivate
+    : public Ksl::ObjectPrivate
+{
+public:
+
+    BfsPrivate(Bfs *publ)
+        : Ksl::ObjectPrivate(publ)
+        , parallel(false)
+        , symmetric(false)
+        , alpha(15.0)
+        , beta(18.0)
+        , inOffsetsOf(nullptr)
+        , inTargetsOf(nullptr)
+        , inCount(0)
+        , inEdgeCount(0)
+        , depth(0)
+        , bottomUpSteps(0)
+    { }
+
+    // Levels with fewer vertices than that are not split
+    static const uint32_t MinThreadVertices = 16384;
+
+
+    // The graph and the state shared by the steps of a search
+    class Search
+    {
+    public:
+
+        uint32_t count;
+        const uint64_t *offsets;
+        const uint32_t *targets;
+        const uint64_t *inOffsets;
+        const uint32_t *inSources;
+        std::atomic<int> *parents;
+        int *distances;
+        int depth;
+    };
+
+
+    // What a thread found in one step
+    class Part
+    {
+    public:
+
+        Part()
+            : found(0)
+            , edges(0)
+        { }
+
+        std::vector<uint32_t> next;
+        uint32_t found;
+        uint64_t edges;
+    };
+
+
+    static Part topDown(const Search *search, const uint32_t *begin,
+                        const uint32_t *end);
+    static Part bottomUp(const Search *search, const uint64_t *frontier,
+                         uint64_t *next, uint32_t begin, uint32_t end);
+    void transpose(uint32_t count, const uint64_t *offsets,
+                   const uint32_t *targets);
+    int threads(uint32_t work) const;
+
+
+    bool parallel;
+    bool symmetric;
+    double alpha;
+    double beta;
+
+    // the transposed graph, when it is not symmetric, and
+    // the graph it was built from
+    std::vector<uint64_t> inOffsets;
+    std::vector<uint32_t> inSources;
+    const uint64_t *inOffsetsOf;
+    const uint32_t *inTargetsOf;
+    uint32_t inCount;
+    uint64_t inEdgeCount;
+
+    Array<1,int> distances;
+    Array<1,int> parents;
+    int depth;
+    int bottomUpSteps;
+};
+
+} // namespace Ksl
+
+#endif // KSL_BFS_P_H
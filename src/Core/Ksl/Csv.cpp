@@ -19,9 +19,17 @@
  */
 
 #include <Ksl/Csv_p.h>
-#include <QFile>
+#include <Ksl/CsvReader_p.h>
+#include <Ksl/NumberFormat.h>
+#include <Ksl/NumberParser_p.h>
+#include <QFileInfo>
+#include <QThread>
+#include <QVarLengthArray>
+#include <QtConcurrentRun>
 #include <QDebug>
-#include <QTextStream>
+#include <algorithm>
+#include <cstring>
+#include <limits>
 
 namespace Ksl {
 
@@ -41,57 +49,76 @@ bool Csv::readAll(const QString &filePath,
                   bool hasHeader, char delimiter)
 {
     KSL_PUBLIC(Csv);
-
+    m->clear();
     m->filePath = filePath;
-    QFile file(m->filePath);
-    if (!file.open(QIODevice::Text|QIODevice::ReadOnly)) {
-        qDebug() << "Csv::readAll: File not found!";
-        return false;
-    }
-    QTextStream str(&file);
+    if (m->cached)
+        return m->readCached(hasHeader, delimiter);
+    return m->readText(hasHeader, delimiter);
+}
 
-    while (!str.atEnd()) {
-        QString line = str.readLine();
-        if (int k = line.indexOf('#') > -1)
-            line.chop(line.size() - k);
-        if (line.isEmpty())
-            continue;
 
-        QStringList attrs = line.split(
-            delimiter, QString::SkipEmptyParts);
-        if (hasHeader) {
-            for (auto &label : attrs) {
-                m->keys.append(label.trimmed());
-                m->columns.append(QVector<QString>());
-            }
-        }
-        else {
-            for (int k=1; k<attrs.size()+1; k++) {
-                m->keys.append(QString::number(k));
-                m->columns.append(QVector<QString>());
-            }
-            if (!str.seek(0))
-                qDebug() << "SEEK error!";
-        }
-        break;
-    }
+void Csv::setParallel(bool parallel) {
+    KSL_PUBLIC(Csv);
+    m->parallel = parallel;
+}
 
-    while (!str.atEnd()) {
-        QString line = str.readLine();
-        if (int k = line.indexOf('#') > -1)
-            line.chop(line.size() - k);
-        if (line.isEmpty())
-            continue;
 
-        QStringList attrs = line.split(
-            delimiter, QString::SkipEmptyParts);
-        auto iter = attrs.begin();
-        for (auto &column : m->columns) {
-            column.append(*iter++);
-        }
-    }
-    m->empty = false;
-    return true;
+bool Csv::parallel() const {
+    KSL_PUBLIC(const Csv);
+    return m->parallel;
+}
+
+
+void Csv::setCached(bool cached) {
+    KSL_PUBLIC(Csv);
+    m->cached = cached;
+}
+
+
+bool Csv::cached() const {
+    KSL_PUBLIC(const Csv);
+    return m->cached;
+}
+
+
+void Csv::setColumns(const QStringList &keys) {
+    KSL_PUBLIC(Csv);
+    m->selectedKeys = keys;
+    m->selectedIndexes.clear();
+}
+
+
+void Csv::setColumns(const Array<1,int> &indexes) {
+    KSL_PUBLIC(Csv);
+    m->selectedKeys.clear();
+    m->selectedIndexes.clear();
+    for (auto index : indexes)
+        m->selectedIndexes.append(index);
+}
+
+
+void Csv::addRowFilter(const QString &key, std::function<bool(double)> accept) {
+    KSL_PUBLIC(Csv);
+    CsvPrivate::RowFilter filter;
+    filter.key = key;
+    filter.index = -1;
+    filter.accept = accept;
+    m->rowFilters.append(filter);
+}
+
+
+void Csv::addRowFilter(int index, std::function<bool(double)> accept) {
+    KSL_PUBLIC(Csv);
+    CsvPrivate::RowFilter filter;
+    filter.index = index;
+    filter.accept = accept;
+    m->rowFilters.append(filter);
+}
+
+
+void Csv::clearRowFilters() {
+    KSL_PUBLIC(Csv);
+    m->rowFilters.clear();
 }
 
 
@@ -103,9 +130,7 @@ bool Csv::empty() const {
 
 int Csv::rows() const {
     KSL_PUBLIC(const Csv);
-    if (m->columns.isEmpty())
-        return 0;
-    return m->columns[0].size();
+    return m->rows;
 }
 
 
@@ -115,84 +140,1125 @@ int Csv::cols() const {
 }
 
 
-const QVector<QString> Csv::column(const QString &key) const {
+QStringList Csv::keys() const {
+    KSL_PUBLIC(const Csv);
+    return m->keys;
+}
+
+
+Csv::ColumnType Csv::columnType(const QString &key) const {
     KSL_PUBLIC(const Csv);
-    if (!m->keys.contains(key))
-        return QVector<QString>();
-    return m->columns.at(m->keys.indexOf(key));
+    return columnType(m->indexOf(key));
 }
 
 
-const QVector<QString> Csv::column(int index) const {
+Csv::ColumnType Csv::columnType(int index) const {
     KSL_PUBLIC(const Csv);
-    return m->columns[index];
+    if (index < 0 || index >= m->columns.size())
+        return Text;
+    return m->columns[index].type;
 }
 
 
-Array<1> Csv::array(const QString &key) const {
-    auto column = this->column(key);
-    if (column.isEmpty())
-        return Array<1>();
+const QVector<QString>& Csv::column(const QString &key) const {
+    KSL_PUBLIC(const Csv);
+    static const QVector<QString> none;
+    int index = m->indexOf(key);
+    if (index < 0)
+        return none;
+    return column(index);
+}
+
 
-    Array<1> ret(column.size());
-    for (int k=0; k<column.size(); ++k)
-        ret[k] = column[k].trimmed().toDouble();
+const QVector<QString>& Csv::column(int index) const {
+    KSL_PUBLIC(const Csv);
+    const CsvPrivate::Column &column = m->columns[index];
+    if (column.type == Text && !column.encoded)
+        return column.texts;
 
+    QMutexLocker lock(&m->cacheMutex);
+    if (!m->textCached[index]) {
+        QVector<QString> &texts = m->textCache[index];
+        texts.resize(m->rows);
+        for (int k=0; k<m->rows; ++k)
+            texts[k] = column.text(k);
+        m->textCached[index] = true;
+    }
+    return m->textCache[index];
+}
+
+
+const Array<1>& Csv::array(const QString &key) const {
+    KSL_PUBLIC(const Csv);
+    static const Array<1> none;
+    int index = m->indexOf(key);
+    if (index < 0)
+        return none;
+    return array(index);
+}
+
+
+const Array<1>& Csv::array(int index) const {
+    KSL_PUBLIC(const Csv);
+    const CsvPrivate::Column &column = m->columns[index];
+    if (column.type == Real)
+        return column.reals;
+
+    QMutexLocker lock(&m->cacheMutex);
+    if (!m->realCached[index]) {
+        Array<1> reals(m->rows);
+        for (int k=0; k<m->rows; ++k)
+            reals[k] = column.real(k);
+        m->realCache[index] = reals;
+        m->realCached[index] = true;
+    }
+    return m->realCache[index];
+}
+
+
+Array<1,int> Csv::intArray(const QString &key) const {
+    KSL_PUBLIC(const Csv);
+    int index = m->indexOf(key);
+    if (index < 0)
+        return Array<1,int>();
+    return intArray(index);
+}
+
+
+Array<1,int> Csv::intArray(int index) const {
+    KSL_PUBLIC(const Csv);
+    const CsvPrivate::Column &column = m->columns[index];
+    if (column.type == Integer)
+        return column.ints;
+
+    const double lo = std::numeric_limits<int>::min();
+    const double hi = std::numeric_limits<int>::max();
+    Array<1,int> ret(m->rows);
+    for (int k=0; k<m->rows; ++k) {
+        double x = column.real(k);
+        if (x != x)
+            ret[k] = 0;
+        else
+            ret[k] = int(qBound(lo, x, hi));
+    }
     return std::move(ret);
 }
 
 
-Array<1> Csv::array(int index) const {
+Array<1,float> Csv::floatArray(const QString &key) const {
     KSL_PUBLIC(const Csv);
-    return array(m->keys[index]);
+    int index = m->indexOf(key);
+    if (index < 0)
+        return Array<1,float>();
+    return floatArray(index);
 }
 
 
-Array<2> Csv::matrix() const {
+Array<1,float> Csv::floatArray(int index) const {
     KSL_PUBLIC(const Csv);
-    Array<2> mat(rows(), cols());
-    int i=0;
-    for (auto &column : m->columns) {
-        for (int j=0; j<column.size(); ++j)
-            mat[j][i] = column[j].trimmed().toDouble();
-        ++i;
+    const CsvPrivate::Column &column = m->columns[index];
+    Array<1,float> ret(m->rows);
+    for (int k=0; k<m->rows; ++k)
+        ret[k] = float(column.real(k));
+    return std::move(ret);
+}
+
+
+bool Csv::isCategorical(const QString &key) const {
+    KSL_PUBLIC(const Csv);
+    return isCategorical(m->indexOf(key));
+}
+
+
+bool Csv::isCategorical(int index) const {
+    KSL_PUBLIC(const Csv);
+    if (index < 0 || index >= m->columns.size())
+        return false;
+    const CsvPrivate::Column &column = m->columns[index];
+    return column.type == Text && column.encoded;
+}
+
+
+QStringList Csv::categories(const QString &key) const {
+    KSL_PUBLIC(const Csv);
+    return categories(m->indexOf(key));
+}
+
+
+QStringList Csv::categories(int index) const {
+    KSL_PUBLIC(const Csv);
+    if (!isCategorical(index))
+        return QStringList();
+    return m->columns[index].categories;
+}
+
+
+Array<1,int> Csv::codes(const QString &key) const {
+    KSL_PUBLIC(const Csv);
+    return codes(m->indexOf(key));
+}
+
+
+Array<1,int> Csv::codes(int index) const {
+    KSL_PUBLIC(const Csv);
+    if (!isCategorical(index))
+        return Array<1,int>();
+    return m->columns[index].codes;
+}
+
+
+Table Csv::table() const {
+    KSL_PUBLIC(const Csv);
+    Table ret;
+    for (int k=0; k<m->columns.size(); ++k) {
+        const CsvPrivate::Column &column = m->columns[k];
+        if (column.type == Integer)
+            ret.append(m->keys[k], TableColumn(column.ints));
+        else if (column.type == Real)
+            ret.append(m->keys[k], TableColumn(column.reals));
+        else if (column.encoded)
+            ret.append(m->keys[k], TableColumn(column.codes, column.categories.toVector()));
+        else
+            ret.append(m->keys[k], TableColumn(column.texts));
     }
+    return std::move(ret);
+}
+
+
+Array<2> Csv::matrix() const {
+    Array<2> mat(rows(), cols());
+    for (int i=0; i<cols(); ++i)
+        fillcol(mat, i, i);
     return std::move(mat);
 }
 
 Array<2> Csv::matrix(int i, int j, int rows, int cols) const {
-    KSL_PUBLIC(const Csv);
     Array<2> mat(rows, cols);
-
-    auto coliter = m->columns.begin();
-    for (int k=0; k<j; ++k)
-        ++coliter;
-
     for (int k=0; k<cols; ++k) {
-        for (int l=i; l<rows; ++l) {
-            mat[l-i][k] = (*coliter)[l].trimmed().toDouble();
-        }
-        ++coliter;
+        const Array<1> &x = array(j+k);
+        for (int l=i; l<i+rows; ++l)
+            mat[l-i][k] = x[l];
     }
     return std::move(mat);
 }
 
 
 void Csv::fillcol(Array<2> &a, int j, const QString &key) const {
-    auto column = this->column(key);
-    if (column.isEmpty())
+    KSL_PUBLIC(const Csv);
+    int index = m->indexOf(key);
+    if (index < 0)
         return;
-    for (int k=0; k<column.size(); ++k)
-        a[k][j] = column[k].trimmed().toDouble();
+    fillcol(a, j, index);
 }
 
 
 void Csv::fillcol(Array<2> &a, int j, int col) const {
-    auto column = this->column(col);
-    if (column.isEmpty())
+    KSL_PUBLIC(const Csv);
+    const Array<1> &x = array(col);
+    const int rows = qMin(m->rows, a.rows());
+    for (int k=0; k<rows; ++k)
+        a[k][j] = x[k];
+}
+
+
+void CsvPrivate::clear() {
+    empty = true;
+    rows = 0;
+    filePath.clear();
+    keys.clear();
+    keyIndex.clear();
+    columns.clear();
+    realCached.clear();
+    textCached.clear();
+    realCache.clear();
+    textCache.clear();
+}
+
+
+int CsvPrivate::indexOf(const QString &key) const {
+    return keyIndex.value(key, -1);
+}
+
+
+bool CsvPrivate::readText(bool hasHeader, char delimiter) {
+    if (parallel && readMapped(hasHeader, delimiter))
+        return true;
+
+    CsvReader reader;
+    if (!reader.open(filePath, hasHeader, delimiter)) {
+        qDebug() << "Csv::readAll: File not found!";
+        return false;
+    }
+    auto source = KSL_GET_PRIVATE(CsvReader, &reader);
+
+    project(reader.keys());
+    const int cols = keys.size();
+    columns.resize(cols);
+    Column *out = columns.data();
+
+    const qint64 dataStart = source->bytesRead;
+    const char *begin, *end;
+    while (source->nextLine(&begin, &end)) {
+        if (!parseLine(begin, end, delimiter, projection, out))
+            continue;
+
+        // guess the number of rows from the first ones, the
+        // size of a compressed file tells nothing
+        if (++rows == SampleRows && !source->source.isCompressed()) {
+            int guess = guessRows(QFileInfo(filePath).size() - dataStart,
+                                  source->bytesRead - dataStart, rows);
+            for (int k=0; k<cols; ++k)
+                out[k].reserve(guess);
+        }
+    }
+    for (int k=0; k<cols; ++k)
+        out[k].releaseLookup();
+    empty = false;
+    return true;
+}
+
+
+bool CsvPrivate::readMapped(bool hasHeader, char delimiter) {
+    // compressed files are read as a stream
+    if (CsvSource::format(filePath) != CsvSource::Plain)
+        return false;
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly) || file.size() == 0)
+        return false;
+    const qint64 size = file.size();
+    const char *data = (const char*) file.map(0, size);
+    if (data == nullptr)
+        return false;
+    const char *last = data + size;
+
+    // The first line gives the keys, or just
+    // the number of columns if there is no header
+    QStringList fileKeys;
+    const char *pos = data;
+    while (pos < last) {
+        const char *lineEnd;
+        const char *newline = CsvFields::findLineEnd(pos, last, delimiter, &lineEnd);
+        const char *next = newline ? newline + 1 : last;
+        if (lineEnd == newline && lineEnd > pos && lineEnd[-1] == '\r')
+            --lineEnd;
+        if (CsvFields::isBlankLine(pos, lineEnd)) {
+            pos = next;
+            continue;
+        }
+
+        CsvFields fields(pos, lineEnd, delimiter);
+        while (fields.next()) {
+            fileKeys.append(hasHeader
+                ? QString::fromUtf8(fields.begin, int(fields.end - fields.begin))
+                : QString::number(fileKeys.size() + 1));
+        }
+        if (hasHeader)
+            pos = next;
+        break;
+    }
+    project(fileKeys);
+
+    // Split the rest at line starts. Quoted fields may hold
+    // newlines, so if there are quotes the split points are
+    // found by walking the lines
+    const int threads = qMax(QThread::idealThreadCount(), 1);
+    QVector<const char*> bounds;
+    bounds.append(pos);
+    if (std::memchr(pos, '"', last - pos) == nullptr) {
+        for (int k=1; k<threads; ++k) {
+            const char *split = pos + (last - pos) * k / threads;
+            split = qMax(split, bounds.last());
+            const char *newline = (const char*) std::memchr(split, '\n', last - split);
+            bounds.append(newline ? newline + 1 : last);
+        }
+    }
+    else {
+        const qint64 step = (last - pos) / threads + 1;
+        const char *iter = pos;
+        while (iter < last) {
+            const char *lineEnd;
+            const char *newline = CsvFields::findLineEnd(iter, last, delimiter, &lineEnd);
+            iter = newline ? newline + 1 : last;
+            if (iter - bounds.last() >= step && bounds.size() < threads)
+                bounds.append(iter);
+        }
+    }
+    bounds.append(last);
+
+    QList< QFuture<Chunk> > futures;
+    for (int k=0; k+1<bounds.size(); ++k) {
+        futures.append(QtConcurrent::run(
+            &CsvPrivate::parseChunk, bounds[k], bounds[k+1], delimiter, &projection));
+    }
+    QVector<Chunk> chunks;
+    for (auto &future : futures)
+        chunks.append(future.result());
+    stitch(chunks);
+
+    file.unmap((uchar*) data);
+    empty = false;
+    return true;
+}
+
+
+// Joins the pieces of each column, in order,
+// using the most general type among them
+void CsvPrivate::stitch(QVector<Chunk> &chunks) {
+    for (auto &chunk : chunks)
+        rows += chunk.rows;
+
+    const int cols = keys.size();
+    columns.resize(cols);
+    for (int j=0; j<cols; ++j) {
+        Column &column = columns[j];
+        for (auto &chunk : chunks) {
+            if (chunk.columns[j].type > column.type)
+                column.type = chunk.columns[j].type;
+        }
+        for (auto &chunk : chunks) {
+            Column &piece = chunk.columns[j];
+            if (piece.type == Csv::Integer && column.type != Csv::Integer)
+                piece.toReal();
+            if (piece.type == Csv::Real && column.type == Csv::Text)
+                piece.toText();
+            if (!piece.encoded)
+                column.encoded = false;
+        }
+
+        if (column.type == Csv::Integer)
+            column.ints = Array<1,int>(rows);
+        else if (column.type == Csv::Real)
+            column.reals = Array<1>(rows);
+        else if (column.encoded)
+            column.codes = Array<1,int>(rows);
+        else
+            column.texts.reserve(rows);
+
+        int offset = 0;
+        for (auto &chunk : chunks) {
+            Column &piece = chunk.columns[j];
+            if (column.type == Csv::Integer) {
+                std::copy(piece.ints.begin(), piece.ints.end(), column.ints.begin() + offset);
+            }
+            else if (column.type == Csv::Real) {
+                std::copy(piece.reals.begin(), piece.reals.end(), column.reals.begin() + offset);
+            }
+            else if (column.encoded) {
+                // the codes of the piece into the merged categories
+                QVector<int> recode(piece.categories.size());
+                for (int k=0; k<recode.size(); ++k)
+                    recode[k] = column.intern(piece.categories[k].toUtf8());
+                for (int k=0; k<chunk.rows; ++k) {
+                    int code = piece.codes[k];
+                    column.codes[offset + k] = (code < 0) ? -1 : recode[code];
+                }
+            }
+            else if (piece.encoded) {
+                for (int k=0; k<chunk.rows; ++k)
+                    column.texts.append(piece.text(k));
+            }
+            else {
+                column.texts += piece.texts;
+            }
+            offset += chunk.rows;
+            piece = Column();
+        }
+
+        const int count = column.categories.size();
+        if (column.encoded && count > Column::CategoryLimit && count > rows/4)
+            column.decode();
+        column.releaseLookup();
+    }
+}
+
+
+// The sidecar starts with this header. Every section after it
+// is padded to 8 bytes, so numbers in a mapped file are aligned
+struct SidecarHeader {
+    char magic[8];
+    quint32 version;
+    quint32 byteOrder;
+    qint64 sourceSize;
+    qint64 sourceModified;
+    qint32 rows;
+    qint32 cols;
+    qint32 hasHeader;
+    qint32 delimiter;
+    qint32 pathBytes;
+    qint32 reserved;
+};
+
+struct SidecarColumn {
+    qint32 type;
+    qint32 keyBytes;
+    qint64 dataBytes;
+};
+
+static const char SidecarMagic[8] = { 'K', 'S', 'L', 'C', 'S', 'V', '\0', '\0' };
+static const quint32 SidecarVersion = 2;
+static const quint32 SidecarByteOrder = 0x01020304;
+static const qint32 SidecarCategorical = 3;
+
+static qint64 padded(qint64 size) {
+    return (size + 7) & ~qint64(7);
+}
+
+// Strings are stored as count+1 offsets followed by the UTF-8 text
+static void packStrings(const QVector<QString> &strings,
+                        QVector<qint64> *offsets, QByteArray *text)
+{
+    offsets->resize(strings.size() + 1);
+    (*offsets)[0] = 0;
+    for (int k=0; k<strings.size(); ++k) {
+        *text += strings[k].toUtf8();
+        (*offsets)[k+1] = text->size();
+    }
+}
+
+static bool unpackStrings(const char *data, qint64 size, qint64 count,
+                          QVector<QString> *strings)
+{
+    const qint64 tableBytes = (count+1)*qint64(sizeof(qint64));
+    if (count < 0 || size < tableBytes)
+        return false;
+    const qint64 *offsets = (const qint64*) data;
+    const char *text = data + tableBytes;
+    const qint64 textBytes = size - tableBytes;
+    strings->reserve(int(count));
+    for (qint64 k=0; k<count; ++k) {
+        if (offsets[k] < 0 || offsets[k] > offsets[k+1] || offsets[k+1] > textBytes)
+            return false;
+        strings->append(QString::fromUtf8(text + offsets[k], int(offsets[k+1] - offsets[k])));
+    }
+    return true;
+}
+
+
+QString CsvPrivate::sidecarPath(const QString &filePath) {
+    return filePath + ".kslcache";
+}
+
+
+bool CsvPrivate::readCached(bool hasHeader, char delimiter) {
+    if (!readSidecar(hasHeader, delimiter)) {
+        // parse the whole file, so that the
+        // sidecar is good for any selection
+        QStringList keptKeys = selectedKeys;
+        QVector<int> keptIndexes = selectedIndexes;
+        QList<RowFilter> keptFilters = rowFilters;
+        selectedKeys.clear();
+        selectedIndexes.clear();
+        rowFilters.clear();
+        bool ok = readText(hasHeader, delimiter);
+        selectedKeys = keptKeys;
+        selectedIndexes = keptIndexes;
+        rowFilters = keptFilters;
+        if (!ok)
+            return false;
+        writeSidecar(hasHeader, delimiter);
+    }
+    select();
+    return true;
+}
+
+
+bool CsvPrivate::readSidecar(bool hasHeader, char delimiter) {
+    QFileInfo source(filePath);
+    QFile file(sidecarPath(filePath));
+    if (!source.exists() || !file.open(QIODevice::ReadOnly))
+        return false;
+
+    const qint64 size = file.size();
+    if (size < qint64(sizeof(SidecarHeader)))
+        return false;
+    const char *data = (const char*) file.map(0, size);
+    if (data == nullptr)
+        return false;
+    const char *last = data + size;
+
+    SidecarHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    const QByteArray path = source.absoluteFilePath().toUtf8();
+    const char *pos = data + sizeof(header);
+
+    bool ok = std::memcmp(header.magic, SidecarMagic, sizeof(SidecarMagic)) == 0
+        && header.version == SidecarVersion
+        && header.byteOrder == SidecarByteOrder
+        && header.sourceSize == source.size()
+        && header.sourceModified == source.lastModified().toMSecsSinceEpoch()
+        && header.hasHeader == qint32(hasHeader)
+        && header.delimiter == qint32(delimiter)
+        && header.rows >= 0 && header.cols >= 0
+        && header.pathBytes == path.size()
+        && last - pos >= padded(header.pathBytes)
+        && std::memcmp(pos, path.constData(), path.size()) == 0;
+    if (ok)
+        pos += padded(header.pathBytes);
+
+    QStringList fileKeys;
+    QVector<Column> fileColumns(ok ? header.cols : 0);
+    for (int j=0; ok && j<header.cols; ++j) {
+        SidecarColumn info;
+        ok = (last - pos >= qint64(sizeof(info)));
+        if (!ok)
+            break;
+        std::memcpy(&info, pos, sizeof(info));
+        pos += sizeof(info);
+        ok = info.keyBytes >= 0 && info.dataBytes >= 0
+            && last - pos >= padded(info.keyBytes) + padded(info.dataBytes);
+        if (!ok)
+            break;
+        fileKeys.append(QString::fromUtf8(pos, info.keyBytes));
+        pos += padded(info.keyBytes);
+
+        Column &column = fileColumns[j];
+        const qint64 rows = header.rows;
+        if (info.type == Csv::Integer && info.dataBytes == rows*qint64(sizeof(int))) {
+            column.type = Csv::Integer;
+            column.ints = Array<1,int>(header.rows);
+            std::memcpy(column.ints.begin(), pos, info.dataBytes);
+        }
+        else if (info.type == Csv::Real && info.dataBytes == rows*qint64(sizeof(double))) {
+            column.type = Csv::Real;
+            column.reals = Array<1>(header.rows);
+            std::memcpy(column.reals.begin(), pos, info.dataBytes);
+        }
+        else if (info.type == Csv::Text) {
+            column.type = Csv::Text;
+            column.encoded = false;
+            ok = unpackStrings(pos, info.dataBytes, rows, &column.texts);
+        }
+        else if (info.type == SidecarCategorical && info.dataBytes >= qint64(sizeof(qint64))) {
+            // category count, codes, categories
+            qint64 count;
+            std::memcpy(&count, pos, sizeof(count));
+            const qint64 codeBytes = padded(rows*qint64(sizeof(int)));
+            const qint64 stringBytes = info.dataBytes - qint64(sizeof(count)) - codeBytes;
+            QVector<QString> categories;
+            ok = stringBytes >= 0
+                && unpackStrings(pos + sizeof(count) + codeBytes, stringBytes, count, &categories);
+            if (ok) {
+                column.type = Csv::Text;
+                column.codes = Array<1,int>(header.rows);
+                std::memcpy(column.codes.begin(), pos + sizeof(count), rows*sizeof(int));
+                column.categories = categories.toList();
+                for (auto code : column.codes)
+                    ok = ok && code >= -1 && code < count;
+            }
+        }
+        else {
+            ok = false;
+        }
+        pos += padded(info.dataBytes);
+    }
+    file.unmap((uchar*) data);
+
+    if (!ok)
+        return false;
+    keys = fileKeys;
+    columns = fileColumns;
+    rows = header.rows;
+    empty = false;
+    return true;
+}
+
+
+bool CsvPrivate::writeSidecar(bool hasHeader, char delimiter) const {
+    QFileInfo source(filePath);
+    const QString path = sidecarPath(filePath);
+    const QString tempPath = path + ".tmp";
+    QFile file(tempPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    static const char zeros[8] = { 0 };
+    bool ok = true;
+    auto write = [&](const void *bytes, qint64 size) {
+        if (ok && size > 0)
+            ok = (file.write((const char*) bytes, size) == size);
+        if (ok && padded(size) > size)
+            ok = (file.write(zeros, padded(size) - size) == padded(size) - size);
+    };
+
+    const QByteArray absolutePath = source.absoluteFilePath().toUtf8();
+    SidecarHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, SidecarMagic, sizeof(SidecarMagic));
+    header.version = SidecarVersion;
+    header.byteOrder = SidecarByteOrder;
+    header.sourceSize = source.size();
+    header.sourceModified = source.lastModified().toMSecsSinceEpoch();
+    header.rows = rows;
+    header.cols = columns.size();
+    header.hasHeader = hasHeader;
+    header.delimiter = delimiter;
+    header.pathBytes = absolutePath.size();
+    write(&header, sizeof(header));
+    write(absolutePath.constData(), absolutePath.size());
+
+    for (int j=0; ok && j<columns.size(); ++j) {
+        const Column &column = columns[j];
+        const QByteArray key = keys[j].toUtf8();
+        SidecarColumn info;
+        std::memset(&info, 0, sizeof(info));
+        info.type = column.type;
+        info.keyBytes = key.size();
+
+        if (column.type == Csv::Integer) {
+            info.dataBytes = qint64(rows) * sizeof(int);
+            write(&info, sizeof(info));
+            write(key.constData(), key.size());
+            write(column.ints.begin(), info.dataBytes);
+        }
+        else if (column.type == Csv::Real) {
+            info.dataBytes = qint64(rows) * sizeof(double);
+            write(&info, sizeof(info));
+            write(key.constData(), key.size());
+            write(column.reals.begin(), info.dataBytes);
+        }
+        else if (column.encoded) {
+            const qint64 count = column.categories.size();
+            QVector<qint64> offsets;
+            QByteArray text;
+            packStrings(column.categories.toVector(), &offsets, &text);
+            info.type = SidecarCategorical;
+            info.dataBytes = qint64(sizeof(count)) + padded(qint64(rows)*sizeof(int))
+                + qint64(offsets.size())*sizeof(qint64) + text.size();
+            write(&info, sizeof(info));
+            write(key.constData(), key.size());
+            write(&count, sizeof(count));
+            write(column.codes.begin(), qint64(rows)*sizeof(int));
+            write(offsets.constData(), qint64(offsets.size())*sizeof(qint64));
+            write(text.constData(), text.size());
+        }
+        else {
+            QVector<qint64> offsets;
+            QByteArray text;
+            packStrings(column.texts, &offsets, &text);
+            info.dataBytes = qint64(offsets.size())*sizeof(qint64) + text.size();
+            write(&info, sizeof(info));
+            write(key.constData(), key.size());
+            write(offsets.constData(), qint64(offsets.size())*sizeof(qint64));
+            write(text.constData(), text.size());
+        }
+    }
+    file.close();
+
+    // replace the old sidecar only with a complete one
+    if (ok) {
+        QFile::remove(path);
+        ok = QFile::rename(tempPath, path);
+    }
+    if (!ok)
+        QFile::remove(tempPath);
+    return ok;
+}
+
+
+// Takes the selected columns and the rows
+// accepted by the filters out of the whole file
+void CsvPrivate::select() {
+    const QStringList fileKeys = keys;
+    const QVector<Column> fileColumns = columns;
+    project(fileKeys);
+    if (projection.identity)
         return;
-    for (int k=0; k<column.size(); ++k)
-        a[k][j] = column[k].trimmed().toDouble();
+
+    const bool filtered = !projection.filters.isEmpty();
+    QVector<int> kept;
+    if (filtered) {
+        for (int k=0; k<rows; ++k) {
+            bool accept = true;
+            for (auto &filter : projection.filters) {
+                accept = filter.accept(fileColumns[filter.field].real(k));
+                if (!accept)
+                    break;
+            }
+            if (accept)
+                kept.append(k);
+        }
+        rows = kept.size();
+    }
+
+    columns.clear();
+    columns.resize(keys.size());
+    for (int field=0; field<fileColumns.size(); ++field) {
+        int col = projection.target[field];
+        if (col >= 0)
+            columns[col] = filtered ? fileColumns[field].select(kept)
+                                    : fileColumns[field];
+    }
+}
+
+
+void CsvPrivate::project(const QStringList &fileKeys) {
+    projection = Projection();
+    projection.target.fill(-1, fileKeys.size());
+    keys.clear();
+    keyIndex.clear();
+
+    QVector<int> fields;
+    if (selectedKeys.isEmpty() && selectedIndexes.isEmpty()) {
+        for (int k=0; k<fileKeys.size(); ++k)
+            fields.append(k);
+    }
+    for (auto &key : selectedKeys) {
+        int field = fileKeys.indexOf(key);
+        if (field < 0)
+            qDebug() << "Csv::readAll: No column" << key;
+        else
+            fields.append(field);
+    }
+    for (auto field : selectedIndexes) {
+        if (field >= 0 && field < fileKeys.size())
+            fields.append(field);
+    }
+
+    for (auto field : fields) {
+        if (projection.target[field] >= 0)
+            continue;
+        if (field != keys.size())
+            projection.identity = false;
+        projection.target[field] = keys.size();
+        projection.lastField = qMax(projection.lastField, field);
+        keys.append(fileKeys[field]);
+    }
+
+    for (auto &filter : rowFilters) {
+        int field = filter.key.isEmpty() ? filter.index : fileKeys.indexOf(filter.key);
+        if (field < 0 || field >= fileKeys.size())
+            continue;
+        Projection::Filter projected;
+        projected.field = field;
+        projected.accept = filter.accept;
+        projection.filters.append(projected);
+        projection.lastField = qMax(projection.lastField, field);
+    }
+
+    projection.cols = keys.size();
+    if (!projection.filters.isEmpty() || projection.cols != fileKeys.size())
+        projection.identity = false;
+    index();
+}
+
+
+void CsvPrivate::index() {
+    // the first of repeated keys wins, as with QStringList::indexOf()
+    keyIndex.clear();
+    for (int k=keys.size()-1; k>=0; --k)
+        keyIndex.insert(keys[k], k);
+    realCached.fill(false, keys.size());
+    textCached.fill(false, keys.size());
+    realCache.resize(keys.size());
+    textCache.resize(keys.size());
+}
+
+
+// Fills the Csv with columns built in memory rather than read
+void CsvPrivate::assign(const QStringList &newKeys,
+                        const QVector<Column> &newColumns, int newRows)
+{
+    clear();
+    keys = newKeys;
+    columns = newColumns;
+    rows = newRows;
+    index();
+    empty = false;
+}
+
+
+bool CsvPrivate::parseLine(const char *begin, const char *end, char delimiter,
+                           const Projection &projection, Column *columns)
+{
+    CsvFields fields(begin, end, delimiter);
+    if (projection.identity) {
+        const int cols = projection.cols;
+        int col = 0;
+        while (col < cols && fields.next())
+            columns[col++].append(fields.begin, fields.end, fields.quoted);
+        while (col < cols)
+            columns[col++].appendMissing();
+        return true;
+    }
+
+    // Remember where the needed fields are, nothing
+    // after the last of them is even tokenised
+    struct Span {
+        const char *begin;
+        const char *end;
+        bool quoted;
+    };
+    const int count = projection.lastField + 1;
+    QVarLengthArray<Span,64> spans(count);
+    int found = 0;
+    while (found < count && fields.next()) {
+        spans[found].begin = fields.begin;
+        spans[found].end = fields.end;
+        spans[found].quoted = fields.quoted;
+        ++found;
+    }
+
+    for (auto &filter : projection.filters) {
+        double x = std::numeric_limits<double>::quiet_NaN();
+        if (filter.field < found)
+            parseDouble(spans[filter.field].begin, spans[filter.field].end, &x);
+        if (!filter.accept(x))
+            return false;
+    }
+
+    for (int field=0; field<count; ++field) {
+        int col = projection.target[field];
+        if (col < 0)
+            continue;
+        if (field < found) {
+            const Span &span = spans[field];
+            columns[col].append(span.begin, span.end, span.quoted);
+        } else {
+            columns[col].appendMissing();
+        }
+    }
+    return true;
+}
+
+
+int CsvPrivate::guessRows(qint64 bytes, qint64 sampleBytes, int sampleRows) {
+    double guess = double(bytes) * sampleRows / double(qMax(sampleBytes, qint64(1))) + 1.0;
+    return int(qMin(guess, double(std::numeric_limits<int>::max())));
+}
+
+
+CsvPrivate::Chunk CsvPrivate::parseChunk(const char *begin, const char *end,
+                                         char delimiter, const Projection *projection)
+{
+    const int cols = projection->cols;
+    Chunk chunk;
+    chunk.columns.resize(cols);
+    Column *columns = chunk.columns.data();
+
+    const char *pos = begin;
+    while (pos < end) {
+        const char *lineEnd;
+        const char *newline = CsvFields::findLineEnd(pos, end, delimiter, &lineEnd);
+        const char *next = newline ? newline + 1 : end;
+        if (lineEnd == newline && lineEnd > pos && lineEnd[-1] == '\r')
+            --lineEnd;
+
+        if (!CsvFields::isBlankLine(pos, lineEnd) &&
+            parseLine(pos, lineEnd, delimiter, *projection, columns))
+        {
+            // guess the number of rows from the first ones
+            if (++chunk.rows == SampleRows) {
+                int guess = guessRows(end - begin, next - begin, chunk.rows);
+                for (int k=0; k<cols; ++k)
+                    columns[k].reserve(guess);
+            }
+        }
+        pos = next;
+    }
+    return chunk;
+}
+
+
+void CsvPrivate::Column::append(const char *begin, const char *end, bool quoted) {
+    if (begin == end) {
+        appendMissing();
+        return;
+    }
+    if (type == Csv::Integer) {
+        int x;
+        if (parseInt(begin, end, &x)) {
+            ints.append(x);
+            return;
+        }
+        toReal();
+    }
+    if (type == Csv::Real) {
+        double x;
+        if (parseDouble(begin, end, &x)) {
+            reals.append(x);
+            return;
+        }
+        toText();
+    }
+
+    if (quoted && std::memchr(begin, '"', end - begin) != nullptr) {
+        QByteArray text(begin, int(end - begin));
+        text.replace("\"\"", "\"");
+        if (encoded)
+            appendCategory(text.constData(), text.constData() + text.size());
+        else
+            texts.append(QString::fromUtf8(text.constData(), text.size()));
+        return;
+    }
+    if (encoded)
+        appendCategory(begin, end);
+    else
+        texts.append(QString::fromUtf8(begin, int(end - begin)));
+}
+
+
+void CsvPrivate::Column::appendMissing() {
+    if (type == Csv::Integer)
+        toReal();
+    if (type == Csv::Real)
+        reals.append(std::numeric_limits<double>::quiet_NaN());
+    else if (encoded)
+        codes.append(-1);
+    else
+        texts.append(QString());
+}
+
+
+void CsvPrivate::Column::appendCategory(const char *begin, const char *end) {
+    const int count = categories.size();
+    codes.append(intern(QByteArray::fromRawData(begin, int(end - begin))));
+
+    // mostly distinct values are cheaper as plain strings
+    if (categories.size() > count && count >= CategoryLimit && count > codes.size()/4)
+        decode();
+}
+
+
+int CsvPrivate::Column::intern(const QByteArray &text) {
+    if (lookup.isEmpty()) {
+        for (int k=0; k<categories.size(); ++k)
+            lookup.insert(categories[k].toUtf8(), k);
+    }
+    auto iter = lookup.constFind(text);
+    if (iter != lookup.constEnd())
+        return iter.value();
+
+    const int code = categories.size();
+    lookup.insert(QByteArray(text.constData(), text.size()), code);
+    categories.append(QString::fromUtf8(text.constData(), text.size()));
+    return code;
+}
+
+
+void CsvPrivate::Column::releaseLookup() {
+    lookup = QHash<QByteArray,int>();
+}
+
+
+void CsvPrivate::Column::reserve(int size) {
+    if (type == Csv::Integer)
+        ints.reserve(size);
+    else if (type == Csv::Real)
+        reals.reserve(size);
+    else if (encoded)
+        codes.reserve(size);
+    else
+        texts.reserve(size);
+}
+
+
+void CsvPrivate::Column::toReal() {
+    reals.reserve(ints.capacity());
+    for (auto x : ints)
+        reals.append(double(x));
+    ints = Array<1,int>();
+    type = Csv::Real;
+}
+
+
+void CsvPrivate::Column::toText() {
+    const bool integer = (type == Csv::Integer);
+    const int size = integer ? ints.size() : reals.size();
+    QVector<QString> values(size);
+    for (int k=0; k<size; ++k)
+        values[k] = text(k);
+
+    codes.reserve(integer ? ints.capacity() : reals.capacity());
+    ints = Array<1,int>();
+    reals = Array<1>();
+    type = Csv::Text;
+    for (auto &value : values) {
+        if (value.isNull()) {
+            appendMissing();
+        }
+        else if (encoded) {
+            QByteArray bytes = value.toUtf8();
+            appendCategory(bytes.constData(), bytes.constData() + bytes.size());
+        }
+        else {
+            texts.append(value);
+        }
+    }
+}
+
+
+void CsvPrivate::Column::decode() {
+    texts.reserve(codes.capacity());
+    for (auto code : codes)
+        texts.append(code < 0 ? QString() : categories[code]);
+    codes = Array<1,int>();
+    categories.clear();
+    lookup.clear();
+    encoded = false;
+}
+
+
+double CsvPrivate::Column::real(int idx) const {
+    if (type == Csv::Integer)
+        return double(ints[idx]);
+    if (type == Csv::Real)
+        return reals[idx];
+
+    QByteArray bytes = text(idx).toUtf8();
+    double x;
+    if (parseDouble(bytes.constData(), bytes.constData() + bytes.size(), &x))
+        return x;
+    return std::numeric_limits<double>::quiet_NaN();
+}
+
+
+QString CsvPrivate::Column::text(int idx) const {
+    if (type == Csv::Integer)
+        return QString::number(ints[idx]);
+    if (type == Csv::Real) {
+        double x = reals[idx];
+        if (x != x)
+            return QString();
+        char buffer[FormatBufferSize];
+        formatDouble(x, buffer);
+        return QString::fromLatin1(buffer);
+    }
+    if (encoded) {
+        int code = codes[idx];
+        return (code < 0) ? QString() : categories[code];
+    }
+    return texts[idx];
+}
+
+
+CsvPrivate::Column CsvPrivate::Column::select(const QVector<int> &rows) const {
+    Column ret;
+    ret.type = type;
+    const int size = rows.size();
+    if (type == Csv::Integer) {
+        ret.ints = Array<1,int>(size);
+        for (int k=0; k<size; ++k)
+            ret.ints[k] = ints[rows[k]];
+    }
+    else if (type == Csv::Real) {
+        ret.reals = Array<1>(size);
+        for (int k=0; k<size; ++k)
+            ret.reals[k] = reals[rows[k]];
+    }
+    else if (encoded) {
+        ret.codes = Array<1,int>(size);
+        for (int k=0; k<size; ++k)
+            ret.codes[k] = codes[rows[k]];
+        ret.categories = categories;
+    }
+    else {
+        ret.encoded = false;
+        ret.texts.reserve(size);
+        for (int k=0; k<size; ++k)
+            ret.texts.append(texts[rows[k]]);
+    }
+    return ret;
 }
 
 } // namespace Ksl
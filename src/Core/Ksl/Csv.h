@@ -23,8 +23,10 @@
 
 #include <Ksl/Object.h>
 #include <Ksl/Array.h>
+#include <Ksl/Table.h>
 #include <QStringList>
 #include <QVector>
+#include <functional>
 
 namespace Ksl {
 
@@ -33,6 +35,13 @@ class KSL_EXPORT Csv
 {
 public:
 
+    enum ColumnType {
+        Integer,
+        Real,
+        Text
+    };
+
+
     Csv();
 
     Csv(const QString &filePath,
@@ -42,6 +51,36 @@ public:
     virtual bool readAll(const QString &filePath,
                          bool hasHeader=true, char delimiter=' ');
 
+    // When set, readAll() maps the file in memory and parses
+    // chunks of it on all cores
+    void setParallel(bool parallel);
+
+    bool parallel() const;
+
+    // When set, readAll() saves the columns it parses in binary
+    // form to filePath + ".kslcache", and later reads them from
+    // there for as long as the file keeps its size and
+    // modification time. The cache always holds every column and
+    // row, setColumns() and addRowFilter() are applied to it
+    void setCached(bool cached);
+
+    bool cached() const;
+
+    // Restricts readAll() to the given columns, in the given
+    // order. The other fields are skipped without conversion
+    void setColumns(const QStringList &keys);
+
+    void setColumns(const Array<1,int> &indexes);
+
+    // Makes readAll() drop the rows for which accept() returns
+    // false on the value of the given column, which does not
+    // need to be one of the columns read
+    void addRowFilter(const QString &key, std::function<bool(double)> accept);
+
+    void addRowFilter(int index, std::function<bool(double)> accept);
+
+    void clearRowFilters();
+
 
     int rows() const;
 
@@ -49,13 +88,49 @@ public:
 
     bool empty() const;
 
-    const QVector<QString> column(const QString &key) const;
+    QStringList keys() const;
+
+    ColumnType columnType(const QString &key) const;
+
+    ColumnType columnType(int index) const;
+
+    // Columns are converted once and kept, the returned
+    // values share storage with the Csv
+    const QVector<QString>& column(const QString &key) const;
+
+    const QVector<QString>& column(int index) const;
+
+    const Array<1>& array(const QString &key) const;
+
+    const Array<1>& array(int index) const;
+
+    // Reals are truncated toward zero and clamped to the
+    // range of int, NaN becomes 0
+    Array<1,int> intArray(const QString &key) const;
+
+    Array<1,int> intArray(int index) const;
+
+    Array<1,float> floatArray(const QString &key) const;
+
+    Array<1,float> floatArray(int index) const;
+
+    // Text columns with few distinct values are stored as the
+    // code of each row into a list of categories, -1 meaning a
+    // missing value. The codes share storage with the Csv
+    bool isCategorical(const QString &key) const;
+
+    bool isCategorical(int index) const;
+
+    QStringList categories(const QString &key) const;
+
+    QStringList categories(int index) const;
 
-    const QVector<QString> column(int index) const;
+    Array<1,int> codes(const QString &key) const;
 
-    Array<1> array(const QString &key) const;
+    Array<1,int> codes(int index) const;
 
-    Array<1> array(int index) const;
+    // The columns as a Table that shares their values
+    Table table() const;
 
     Array<2> matrix() const;
 
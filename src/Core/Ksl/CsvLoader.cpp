@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Ksl/CsvLoader_p.h>
+#include <Ksl/CsvReader_p.h>
+#include <QFileInfo>
+#include <QtConcurrentRun>
+
+namespace Ksl {
+
+CsvLoader::CsvLoader(QObject *parent)
+    : QObject(parent)
+    , Ksl::Object(new CsvLoaderPrivate(this))
+{ }
+
+
+CsvLoader::~CsvLoader() {
+    KSL_PUBLIC(CsvLoader);
+    cancel();
+    m->future.waitForFinished();
+}
+
+
+bool CsvLoader::start(const QString &filePath,
+                      bool hasHeader, char delimiter)
+{
+    KSL_PUBLIC(CsvLoader);
+    if (m->future.isRunning())
+        return false;
+
+    m->filePath = filePath;
+    m->hasHeader = hasHeader;
+    m->delimiter = delimiter;
+    m->canceled.fetchAndStoreOrdered(0);
+    m->ok = false;
+    {
+        QMutexLocker lock(&m->mutex);
+        m->done = false;
+        m->keys.clear();
+        m->chunks.clear();
+        m->bytesRead = 0;
+        m->bytesTotal = 0;
+        if (CsvSource::format(filePath) == CsvSource::Plain)
+            m->bytesTotal = QFileInfo(filePath).size();
+        m->rowsRead = 0;
+    }
+    m->future = QtConcurrent::run(&CsvLoaderPrivate::load, m);
+    return true;
+}
+
+
+bool CsvLoader::isRunning() const {
+    KSL_PUBLIC(const CsvLoader);
+    return m->future.isRunning();
+}
+
+
+bool CsvLoader::isCanceled() const {
+    KSL_PUBLIC(const CsvLoader);
+    return m->canceled != 0;
+}
+
+
+bool CsvLoader::wait() {
+    KSL_PUBLIC(CsvLoader);
+    m->future.waitForFinished();
+    return m->ok;
+}
+
+
+Csv& CsvLoader::csv() {
+    KSL_PUBLIC(CsvLoader);
+    return m->csv;
+}
+
+
+const Csv& CsvLoader::csv() const {
+    KSL_PUBLIC(const CsvLoader);
+    return m->csv;
+}
+
+
+QStringList CsvLoader::keys() const {
+    KSL_PUBLIC(const CsvLoader);
+    QMutexLocker lock(&m->mutex);
+    return m->keys;
+}
+
+
+qint64 CsvLoader::bytesRead() const {
+    KSL_PUBLIC(const CsvLoader);
+    QMutexLocker lock(&m->mutex);
+    return m->bytesRead;
+}
+
+
+qint64 CsvLoader::bytesTotal() const {
+    KSL_PUBLIC(const CsvLoader);
+    QMutexLocker lock(&m->mutex);
+    return m->bytesTotal;
+}
+
+
+int CsvLoader::rowsRead() const {
+    KSL_PUBLIC(const CsvLoader);
+    QMutexLocker lock(&m->mutex);
+    return m->rowsRead;
+}
+
+
+Array<1> CsvLoader::loadedArray(int index) const {
+    KSL_PUBLIC(const CsvLoader);
+    QMutexLocker lock(&m->mutex);
+    if (index < 0 || index >= m->keys.size())
+        return Array<1>();
+    if (m->done)
+        return m->csv.array(index);
+
+    // batches are not touched once published
+    Array<1> ret(m->rowsRead);
+    int offset = 0;
+    for (auto &chunk : m->chunks) {
+        const CsvPrivate::Column &column = chunk.columns[index];
+        for (int k=0; k<chunk.rows; ++k)
+            ret[offset + k] = column.real(k);
+        offset += chunk.rows;
+    }
+    return std::move(ret);
+}
+
+
+Array<1> CsvLoader::loadedArray(const QString &key) const {
+    KSL_PUBLIC(const CsvLoader);
+    int index;
+    {
+        QMutexLocker lock(&m->mutex);
+        index = m->keys.indexOf(key);
+    }
+    return loadedArray(index);
+}
+
+
+void CsvLoader::cancel() {
+    KSL_PUBLIC(CsvLoader);
+    m->canceled.fetchAndStoreOrdered(1);
+}
+
+
+void CsvLoaderPrivate::load(CsvLoaderPrivate *m) {
+    m->ok = m->parse();
+    emit KSL_GET_PUBLIC(CsvLoader, m)->finished(m->ok);
+}
+
+
+// Parses the file in batches of rows, each batch is published
+// for loadedArray() and stitched to the others at the end
+bool CsvLoaderPrivate::parse() {
+    auto publ = KSL_GET_PUBLIC(CsvLoader, this);
+    auto table = KSL_GET_PRIVATE(Csv, &csv);
+    table->clear();
+    table->filePath = filePath;
+
+    CsvReader reader;
+    if (!reader.open(filePath, hasHeader, delimiter))
+        return fail();
+    auto source = KSL_GET_PRIVATE(CsvReader, &reader);
+
+    table->project(reader.keys());
+    const int cols = table->keys.size();
+    {
+        QMutexLocker lock(&mutex);
+        keys = table->keys;
+    }
+
+    const char *begin, *end;
+    bool more = true;
+    while (more) {
+        if (canceled != 0)
+            return fail();
+
+        CsvPrivate::Chunk chunk;
+        chunk.columns.resize(cols);
+        for (auto &column : chunk.columns)
+            column.reserve(BatchRows);
+        CsvPrivate::Column *columns = chunk.columns.data();
+        while (chunk.rows < BatchRows && (more = source->nextLine(&begin, &end))) {
+            if (CsvPrivate::parseLine(begin, end, delimiter, table->projection, columns))
+                chunk.rows += 1;
+        }
+
+        qint64 bytes;
+        int rows;
+        {
+            QMutexLocker lock(&mutex);
+            if (chunk.rows > 0)
+                chunks.append(chunk);
+            rowsRead += chunk.rows;
+            bytesRead = source->bytesRead;
+            bytes = bytesRead;
+            rows = rowsRead;
+        }
+        emit publ->progress(bytes, bytesTotal, rows);
+    }
+
+    QMutexLocker lock(&mutex);
+    table->stitch(chunks);
+    table->empty = false;
+    chunks.clear();
+    done = true;
+    return true;
+}
+
+
+// Leaves an empty table, with no keys for columns
+// that were never stitched
+bool CsvLoaderPrivate::fail() {
+    auto table = KSL_GET_PRIVATE(Csv, &csv);
+    QMutexLocker lock(&mutex);
+    table->clear();
+    keys.clear();
+    chunks.clear();
+    return false;
+}
+
+} // namespace Ksl
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KSL_CSVLOADER_H
+#define KSL_CSVLOADER_H
+
+#include <Ksl/Csv.h>
+#include <QObject>
+
+namespace Ksl {
+
+// Reads a Csv on a thread of the global thread pool, so that the
+// thread that starts the load, usually the GUI one, goes on. The
+// signals come from the loading thread and reach objects of other
+// threads as queued calls. The rows read so far can be taken at
+// any time, to draw them before the whole file is in
+class KSL_EXPORT CsvLoader
+    : public QObject
+    , public Ksl::Object
+{
+    Q_OBJECT
+
+public:
+
+    CsvLoader(QObject *parent=0);
+
+    // Cancels a running load and waits for it to stop
+    ~CsvLoader();
+
+
+    // Starts loading the file. Returns false if a load is running
+    bool start(const QString &filePath,
+               bool hasHeader=true, char delimiter=' ');
+
+    bool isRunning() const;
+
+    bool isCanceled() const;
+
+    // Blocks until the load ends, returns true if it succeeded
+    bool wait();
+
+    // The table being loaded. Set it up (setColumns(),
+    // addRowFilter()...) before start() and read it after
+    // finished(true). It must not be touched while isRunning(),
+    // a failed or canceled load leaves it empty
+    Csv& csv();
+
+    const Csv& csv() const;
+
+    QStringList keys() const;
+
+    qint64 bytesRead() const;
+
+    // The size of the file, or 0 if it is compressed
+    qint64 bytesTotal() const;
+
+    int rowsRead() const;
+
+    // The values of a column in the rows read so far,
+    // text fields are NaN
+    Array<1> loadedArray(int index) const;
+
+    Array<1> loadedArray(const QString &key) const;
+
+
+public slots:
+
+    void cancel();
+
+
+signals:
+
+    // Emitted after each batch of rows
+    void progress(qint64 bytesRead, qint64 bytesTotal, int rowsRead);
+
+    // Emitted when the load ends, ok is false if the
+    // file could not be read or the load was canceled
+    void finished(bool ok);
+
+
+private:
+
+    friend class CsvLoaderPrivate;
+};
+
+} // namespace Ksl
+
+#endif // KSL_CSVLOADER_H
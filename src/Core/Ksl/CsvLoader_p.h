@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the public Ksl API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed. Do not include it
+//
+// We mean it.
+//
+
+#ifndef KSL_CSVLOADER_P_H
+#define KSL_CSVLOADER_P_H
+
+#include <Ksl/CsvLoader.h>
+#include <Ksl/Csv_p.h>
+#include <QFuture>
+#include <QMutex>
+#include <QAtomicInt>
+
+namespace Ksl {
+
+class CsvLoaderPrivate
+    : public Ksl::ObjectPrivate
+{
+public:
+
+    CsvLoaderPrivate(CsvLoader *publ)
+        : Ksl::ObjectPrivate(publ)
+        , hasHeader(true)
+        , delimiter(' ')
+        , ok(false)
+        , done(false)
+        , bytesRead(0)
+        , bytesTotal(0)
+        , rowsRead(0)
+    { }
+
+
+    static const int BatchRows = 1 << 14;
+
+    static void load(CsvLoaderPrivate *m);
+    bool parse();
+    bool fail();
+
+
+    QString filePath;
+    bool hasHeader;
+    char delimiter;
+    Csv csv;
+    QFuture<void> future;
+    QAtomicInt canceled;
+    bool ok;
+
+    // shared with the loading thread
+    mutable QMutex mutex;
+    bool done;
+    QStringList keys;
+    QVector<CsvPrivate::Chunk> chunks;
+    qint64 bytesRead;
+    qint64 bytesTotal;
+    int rowsRead;
+};
+
+} // namespace Ksl
+
+#endif // KSL_CSVLOADER_P_H
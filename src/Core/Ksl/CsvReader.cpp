@@ -0,0 +1,454 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Ksl/CsvReader_p.h>
+#include <Ksl/NumberParser_p.h>
+#include <QtConcurrentRun>
+#include <QDebug>
+#include <cstring>
+#include <limits>
+
+#ifdef KSL_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef KSL_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace Ksl {
+
+CsvReader::CsvReader()
+    : Ksl::Object(new CsvReaderPrivate(this))
+{ }
+
+
+CsvReader::CsvReader(const QString &filePath,
+                     bool hasHeader, char delimiter)
+    : Ksl::Object(new CsvReaderPrivate(this))
+{
+    open(filePath, hasHeader, delimiter);
+}
+
+
+bool CsvReader::open(const QString &filePath,
+                     bool hasHeader, char delimiter)
+{
+    KSL_PUBLIC(CsvReader);
+    close();
+
+    if (!m->source.open(filePath))
+        return false;
+    m->hasHeader = hasHeader;
+    m->delimiter = delimiter;
+
+    // The first line gives the keys, or just
+    // the number of columns if there is no header
+    const char *begin, *end;
+    if (!m->nextLine(&begin, &end))
+        return true;
+
+    CsvFields fields(begin, end, delimiter);
+    if (hasHeader) {
+        while (fields.next()) {
+            m->keys.append(QString::fromUtf8(
+                fields.begin, int(fields.end - fields.begin)));
+        }
+    }
+    else {
+        int count = 0;
+        while (fields.next())
+            ++count;
+        for (int k=1; k<count+1; k++)
+            m->keys.append(QString::number(k));
+
+        // unread the line so that it comes as data
+        int lineStart = int(begin - m->buffer.constData());
+        m->bytesRead -= m->bufferPos - lineStart;
+        m->bufferPos = lineStart;
+    }
+    return true;
+}
+
+
+void CsvReader::close() {
+    KSL_PUBLIC(CsvReader);
+    m->source.close();
+    m->buffer.clear();
+    m->bufferPos = 0;
+    m->keys.clear();
+    m->rowsRead = 0;
+    m->bytesRead = 0;
+}
+
+
+bool CsvReader::isOpen() const {
+    KSL_PUBLIC(const CsvReader);
+    return m->source.isOpen();
+}
+
+
+bool CsvReader::atEnd() const {
+    KSL_PUBLIC(const CsvReader);
+    if (!m->source.isOpen())
+        return true;
+    return m->source.atEnd() && m->bufferPos >= m->buffer.size();
+}
+
+
+QStringList CsvReader::keys() const {
+    KSL_PUBLIC(const CsvReader);
+    return m->keys;
+}
+
+
+int CsvReader::cols() const {
+    KSL_PUBLIC(const CsvReader);
+    return m->keys.size();
+}
+
+
+qint64 CsvReader::rowsRead() const {
+    KSL_PUBLIC(const CsvReader);
+    return m->rowsRead;
+}
+
+
+qint64 CsvReader::bytesRead() const {
+    KSL_PUBLIC(const CsvReader);
+    return m->bytesRead;
+}
+
+
+int CsvReader::read(Array<2> &batch, int maxRows) {
+    KSL_PUBLIC(CsvReader);
+    const int cols = m->keys.size();
+    if (!m->source.isOpen() || cols == 0 || maxRows < 1)
+        return 0;
+
+    if (batch.rows() != maxRows || batch.cols() != cols)
+        batch.resize(maxRows, cols);
+
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const char *begin, *end;
+    int row = 0;
+
+    while (row < maxRows && m->nextLine(&begin, &end)) {
+        double *out = batch[row++];
+        CsvFields fields(begin, end, m->delimiter);
+        int col = 0;
+        while (col < cols && fields.next())
+            out[col++] = CsvReaderPrivate::toDouble(fields.begin, fields.end);
+        while (col < cols)
+            out[col++] = nan;
+    }
+
+    if (row < maxRows)
+        batch.resize(row, cols);
+    m->rowsRead += row;
+    return row;
+}
+
+
+double CsvReaderPrivate::toDouble(const char *begin, const char *end) {
+    double x;
+    if (parseDouble(begin, end, &x))
+        return x;
+    return std::numeric_limits<double>::quiet_NaN();
+}
+
+
+bool CsvReaderPrivate::nextLine(const char **begin, const char **end) {
+    for (;;) {
+        const char *data = buffer.constData();
+        const char *pos = data + bufferPos;
+        const char *last = data + buffer.size();
+        const char *lineEnd;
+        const char *newline = CsvFields::findLineEnd(pos, last, delimiter, &lineEnd);
+
+        if (newline == nullptr) {
+            // a line may continue in the next block
+            if (fill())
+                continue;
+            if (pos == last)
+                return false;
+            newline = last;
+        }
+
+        bufferPos = int(newline - data) + (newline < last ? 1 : 0);
+        bytesRead += (data + bufferPos) - pos;
+
+        if (lineEnd == newline && lineEnd > pos && lineEnd[-1] == '\r')
+            --lineEnd;
+
+        if (CsvFields::isBlankLine(pos, lineEnd))
+            continue;
+
+        *begin = pos;
+        *end = lineEnd;
+        return true;
+    }
+}
+
+
+bool CsvReaderPrivate::fill() {
+    if (!source.isOpen() || source.atEnd())
+        return false;
+
+    // keep the unfinished line at the start of the buffer
+    int keep = buffer.size() - bufferPos;
+    if (bufferPos > 0 && keep > 0)
+        std::memmove(buffer.data(), buffer.constData() + bufferPos, keep);
+    buffer.resize(keep + BlockSize);
+
+    qint64 count = source.read(buffer.data() + keep, BlockSize);
+    buffer.resize(keep + int(qMax(count, qint64(0))));
+    bufferPos = 0;
+    return count > 0;
+}
+
+
+// Inflates a compressed file one block at a time
+class CsvSource::Inflater
+{
+public:
+
+    Inflater(QFile *file, Format format)
+        : file(file)
+        , format(format)
+        , inputPos(0)
+        , failed(false)
+    { }
+
+    ~Inflater() {
+#ifdef KSL_HAVE_ZLIB
+        if (format == Gzip)
+            inflateEnd(&gzip);
+#endif
+#ifdef KSL_HAVE_ZSTD
+        if (format == Zstd)
+            ZSTD_freeDStream(zstd);
+#endif
+    }
+
+    static const int InputSize = 1 << 18;
+
+    bool init();
+    bool refill();
+    QByteArray next();
+
+
+    QFile *file;
+    Format format;
+    QByteArray input;
+    int inputPos;
+    bool failed;
+#ifdef KSL_HAVE_ZLIB
+    z_stream gzip;
+#endif
+#ifdef KSL_HAVE_ZSTD
+    ZSTD_DStream *zstd;
+#endif
+};
+
+
+bool CsvSource::Inflater::init() {
+    if (format == Gzip) {
+#ifdef KSL_HAVE_ZLIB
+        std::memset(&gzip, 0, sizeof(gzip));
+        if (inflateInit2(&gzip, 15 + 16) == Z_OK)
+            return true;
+#else
+        qDebug() << "CsvReader::open: Built without gzip support!";
+#endif
+        format = Plain;
+        return false;
+    }
+#ifdef KSL_HAVE_ZSTD
+    zstd = ZSTD_createDStream();
+    if (zstd != nullptr && !ZSTD_isError(ZSTD_initDStream(zstd)))
+        return true;
+    ZSTD_freeDStream(zstd);
+#else
+    qDebug() << "CsvReader::open: Built without zstd support!";
+#endif
+    format = Plain;
+    return false;
+}
+
+
+bool CsvSource::Inflater::refill() {
+    input.resize(InputSize);
+    qint64 count = file->read(input.data(), InputSize);
+    input.resize(int(qMax(count, qint64(0))));
+    inputPos = 0;
+    return count > 0;
+}
+
+
+QByteArray CsvSource::Inflater::next() {
+    QByteArray out;
+    out.resize(CsvReaderPrivate::BlockSize);
+    int produced = 0;
+
+    while (produced < out.size() && !failed) {
+        if (inputPos == input.size() && !refill())
+            break;
+#ifdef KSL_HAVE_ZLIB
+        if (format == Gzip) {
+            gzip.next_in = (Bytef*) input.data() + inputPos;
+            gzip.avail_in = uInt(input.size() - inputPos);
+            gzip.next_out = (Bytef*) out.data() + produced;
+            gzip.avail_out = uInt(out.size() - produced);
+            int status = inflate(&gzip, Z_NO_FLUSH);
+            inputPos = input.size() - int(gzip.avail_in);
+            produced = out.size() - int(gzip.avail_out);
+            // gzip files may hold several members
+            if (status == Z_STREAM_END)
+                status = inflateReset(&gzip);
+            if (status != Z_OK && status != Z_BUF_ERROR) {
+                qDebug() << "CsvReader: Broken gzip data!";
+                failed = true;
+            }
+        }
+#endif
+#ifdef KSL_HAVE_ZSTD
+        if (format == Zstd) {
+            ZSTD_inBuffer from = { input.constData(), size_t(input.size()), size_t(inputPos) };
+            ZSTD_outBuffer to = { out.data(), size_t(out.size()), size_t(produced) };
+            size_t status = ZSTD_decompressStream(zstd, &to, &from);
+            inputPos = int(from.pos);
+            produced = int(to.pos);
+            if (ZSTD_isError(status)) {
+                qDebug() << "CsvReader: Broken zstd data!";
+                failed = true;
+            }
+        }
+#endif
+    }
+    out.resize(produced);
+    return out;
+}
+
+
+CsvSource::CsvSource()
+    : inflater(nullptr)
+    , blockPos(0)
+    , inflating(false)
+{ }
+
+
+CsvSource::~CsvSource() {
+    close();
+}
+
+
+CsvSource::Format CsvSource::format(const QString &filePath) {
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return Plain;
+    unsigned char magic[4] = { 0, 0, 0, 0 };
+    file.read((char*) magic, 4);
+    if (magic[0] == 0x1f && magic[1] == 0x8b)
+        return Gzip;
+    if (magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd)
+        return Zstd;
+    return Plain;
+}
+
+
+bool CsvSource::open(const QString &filePath) {
+    close();
+    const Format fileFormat = format(filePath);
+
+    file.setFileName(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "CsvReader::open: File not found!";
+        return false;
+    }
+    if (fileFormat == Plain)
+        return true;
+
+    inflater = new Inflater(&file, fileFormat);
+    if (!inflater->init()) {
+        close();
+        return false;
+    }
+    ahead = QtConcurrent::run(&CsvSource::inflateBlock, inflater);
+    inflating = true;
+    return true;
+}
+
+
+void CsvSource::close() {
+    if (inflating)
+        ahead.waitForFinished();
+    inflating = false;
+    delete inflater;
+    inflater = nullptr;
+    block.clear();
+    blockPos = 0;
+    if (file.isOpen())
+        file.close();
+}
+
+
+bool CsvSource::isOpen() const {
+    return file.isOpen();
+}
+
+
+bool CsvSource::atEnd() const {
+    if (inflater == nullptr)
+        return file.atEnd();
+    return !inflating && blockPos == block.size();
+}
+
+
+qint64 CsvSource::read(char *data, qint64 maxSize) {
+    if (inflater == nullptr)
+        return file.read(data, maxSize);
+
+    qint64 count = 0;
+    while (count < maxSize) {
+        if (blockPos == block.size()) {
+            if (!inflating)
+                break;
+            block = ahead.result();
+            blockPos = 0;
+            if (block.isEmpty()) {
+                inflating = false;
+                break;
+            }
+            ahead = QtConcurrent::run(&CsvSource::inflateBlock, inflater);
+        }
+        int size = int(qMin(maxSize - count, qint64(block.size() - blockPos)));
+        std::memcpy(data + count, block.constData() + blockPos, size);
+        blockPos += size;
+        count += size;
+    }
+    return count;
+}
+
+
+QByteArray CsvSource::inflateBlock(Inflater *inflater) {
+    return inflater->next();
+}
+
+} // namespace Ksl
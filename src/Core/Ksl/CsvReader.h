@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KSL_CSVREADER_H
+#define KSL_CSVREADER_H
+
+#include <Ksl/Object.h>
+#include <Ksl/Array.h>
+#include <QStringList>
+
+namespace Ksl {
+
+// Reads a delimited text file in batches of rows, holding only
+// one block of the file in memory at a time. Fields that are
+// missing or not numeric are read as NaN
+class KSL_EXPORT CsvReader
+    : public Ksl::Object
+{
+public:
+
+    CsvReader();
+
+    CsvReader(const QString &filePath,
+              bool hasHeader=true, char delimiter=' ');
+
+
+    bool open(const QString &filePath,
+              bool hasHeader=true, char delimiter=' ');
+
+    void close();
+
+    bool isOpen() const;
+
+    bool atEnd() const;
+
+    QStringList keys() const;
+
+    int cols() const;
+
+    qint64 rowsRead() const;
+
+    qint64 bytesRead() const;
+
+    // Reads up to maxRows rows into batch, which is resized to
+    // hold them, and returns the number of rows read. The storage
+    // of batch is reused, so copy() it to keep it across calls
+    int read(Array<2> &batch, int maxRows=4096);
+
+    // Calls func(const Array<2> &batch) for every batch of
+    // batchRows rows until the end of the file
+    template <typename Func>
+    qint64 forEach(Func func, int batchRows=4096) {
+        Array<2> batch;
+        while (read(batch, batchRows) > 0)
+            func(static_cast<const Array<2>&>(batch));
+        return rowsRead();
+    }
+};
+
+} // namespace Ksl
+
+#endif // KSL_CSVREADER_H
@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the public Ksl API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed. Do not include it
+//
+// We mean it.
+//
+
+#ifndef KSL_CSVREADER_P_H
+#define KSL_CSVREADER_P_H
+
+#include <Ksl/CsvReader.h>
+#include <QFile>
+#include <QFuture>
+#include <cstring>
+
+namespace Ksl {
+
+// Splits one line of text into fields. A blank delimiter (' ' or
+// '\t') makes any run of blanks a single separator, other
+// delimiters separate exactly one field, which may be empty.
+// Fields are trimmed of surrounding blanks. A field starting with
+// '"' runs to the matching quote and may hold delimiters, '#' and
+// newlines, with "" standing for a literal quote
+class CsvFields
+{
+public:
+
+    CsvFields(const char *lineBegin, const char *lineEnd, char delimiter)
+        : begin(lineBegin)
+        , end(lineBegin)
+        , quoted(false)
+        , pos(lineBegin)
+        , lineEnd(lineEnd)
+        , delimiter(delimiter)
+        , done(false)
+    { }
+
+    static bool isBlank(char c) { return c == ' ' || c == '\t'; }
+
+    static bool isBlankLine(const char *begin, const char *end) {
+        while (begin < end && isBlank(*begin))
+            ++begin;
+        return begin == end;
+    }
+
+    // Finds the newline ending the line that starts at pos, or
+    // returns nullptr if the line does not end before last.
+    // contentEnd is set to where a comment starts, or to the end
+    // of the line if there is no comment. Like next(), only a
+    // quote that starts a field opens a quoted run
+    static const char* findLineEnd(const char *pos, const char *last,
+                                   char delimiter, const char **contentEnd);
+
+    bool next();
+
+
+    const char *begin;
+    const char *end;
+    bool quoted;
+
+private:
+
+    const char *pos;
+    const char *lineEnd;
+    char delimiter;
+    bool done;
+};
+
+
+inline const char* CsvFields::findLineEnd(const char *pos, const char *last,
+                                          char delimiter, const char **contentEnd)
+{
+    const char *newline = (const char*) std::memchr(pos, '\n', last - pos);
+    const char *stop = newline ? newline : last;
+    const char *quote = (const char*) std::memchr(pos, '"', stop - pos);
+    const char *comment = (const char*) std::memchr(pos, '#', stop - pos);
+
+    if (quote == nullptr || (comment != nullptr && comment < quote)) {
+        *contentEnd = comment ? comment : stop;
+        return newline;
+    }
+
+    // quoted fields hide newlines and comments
+    const bool blankDelimiter = isBlank(delimiter);
+    bool fieldStart = true;
+    bool inQuotes = false;
+    for (const char *p = pos; p < last; ++p) {
+        if (inQuotes) {
+            if (*p == '"') {
+                if (p+1 < last && p[1] == '"')
+                    ++p;
+                else
+                    inQuotes = false;
+            }
+        }
+        else if (*p == '#') {
+            *contentEnd = p;
+            return (const char*) std::memchr(p, '\n', last - p);
+        }
+        else if (*p == '\n') {
+            *contentEnd = p;
+            return p;
+        }
+        else if (*p == delimiter || (blankDelimiter && isBlank(*p))) {
+            fieldStart = true;
+        }
+        else if (!isBlank(*p)) {
+            inQuotes = fieldStart && *p == '"';
+            fieldStart = false;
+        }
+    }
+    *contentEnd = last;
+    return nullptr;
+}
+
+
+inline bool CsvFields::next() {
+    if (done)
+        return false;
+
+    const bool blankDelimiter = isBlank(delimiter);
+    while (pos < lineEnd && isBlank(*pos))
+        ++pos;
+    if (blankDelimiter && pos == lineEnd) {
+        done = true;
+        return false;
+    }
+
+    quoted = (pos < lineEnd && *pos == '"');
+    if (quoted) {
+        begin = ++pos;
+        while (pos < lineEnd) {
+            if (*pos == '"') {
+                if (pos+1 < lineEnd && pos[1] == '"') {
+                    pos += 2;
+                    continue;
+                }
+                break;
+            }
+            ++pos;
+        }
+        end = pos;
+        if (pos < lineEnd)
+            ++pos;
+    }
+    else {
+        begin = pos;
+    }
+
+    if (blankDelimiter) {
+        while (pos < lineEnd && !isBlank(*pos))
+            ++pos;
+    } else {
+        while (pos < lineEnd && *pos != delimiter)
+            ++pos;
+    }
+    if (!quoted) {
+        end = pos;
+        while (end > begin && isBlank(end[-1]))
+            --end;
+    }
+    if (!blankDelimiter) {
+        if (pos == lineEnd)
+            done = true;
+        else
+            ++pos;
+    }
+    return true;
+}
+
+
+// The bytes of a file, inflated on the fly if it is gzip or
+// zstd compressed (when built with KSL_HAVE_ZLIB or
+// KSL_HAVE_ZSTD). The next block is inflated on another
+// thread while the reader splits the current one
+class CsvSource
+{
+public:
+
+    enum Format {
+        Plain,
+        Gzip,
+        Zstd
+    };
+
+    CsvSource();
+
+    ~CsvSource();
+
+    // Tells the format from the first bytes of the file
+    static Format format(const QString &filePath);
+
+    bool open(const QString &filePath);
+    void close();
+    bool isOpen() const;
+    bool atEnd() const;
+    bool isCompressed() const { return inflater != nullptr; }
+    qint64 read(char *data, qint64 maxSize);
+
+
+private:
+
+    class Inflater;
+
+    static QByteArray inflateBlock(Inflater *inflater);
+
+    QFile file;
+    Inflater *inflater;
+    QFuture<QByteArray> ahead;
+    QByteArray block;
+    int blockPos;
+    bool inflating;
+};
+
+
+class CsvReaderPrivate
+    : public Ksl::ObjectPrivate
+{
+public:
+
+    CsvReaderPrivate(CsvReader *publ)
+        : Ksl::ObjectPrivate(publ)
+        , hasHeader(true)
+        , delimiter(' ')
+        , bufferPos(0)
+        , rowsRead(0)
+        , bytesRead(0)
+    { }
+
+
+    static const int BlockSize = 1 << 20;
+
+    static double toDouble(const char *begin, const char *end);
+
+    bool nextLine(const char **begin, const char **end);
+    bool fill();
+
+
+    bool hasHeader;
+    char delimiter;
+    CsvSource source;
+    QByteArray buffer;
+    int bufferPos;
+    QStringList keys;
+    qint64 rowsRead;
+    qint64 bytesRead;
+};
+
+} // namespace Ksl
+
+#endif // KSL_CSVREADER_P_H
@@ -0,0 +1,383 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Ksl/CsvWriter_p.h>
+#include <Ksl/CsvReader_p.h>
+#include <Ksl/NumberFormat.h>
+#include <QThread>
+#include <QtConcurrentRun>
+#include <QDebug>
+#include <cstring>
+#include <cmath>
+
+namespace Ksl {
+
+CsvWriter::CsvWriter()
+    : Ksl::Object(new CsvWriterPrivate(this))
+{ }
+
+
+CsvWriter::CsvWriter(const QString &filePath, char delimiter)
+    : Ksl::Object(new CsvWriterPrivate(this))
+{
+    open(filePath, delimiter);
+}
+
+
+CsvWriter::~CsvWriter() {
+    close();
+}
+
+
+bool CsvWriter::open(const QString &filePath, char delimiter) {
+    KSL_PUBLIC(CsvWriter);
+    close();
+
+    m->file.setFileName(filePath);
+    if (!m->file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << "CsvWriter::open: Can't open file for writing!";
+        return false;
+    }
+    m->delimiter = delimiter;
+    m->buffer.reserve(CsvWriterPrivate::BufferSize);
+    return true;
+}
+
+
+bool CsvWriter::close() {
+    KSL_PUBLIC(CsvWriter);
+    if (!m->file.isOpen())
+        return true;
+    bool ok = m->writeBuffer();
+    m->file.close();
+    m->buffer.clear();
+    m->rowsWritten = 0;
+    m->bytesWritten = 0;
+    return ok;
+}
+
+
+bool CsvWriter::isOpen() const {
+    KSL_PUBLIC(const CsvWriter);
+    return m->file.isOpen();
+}
+
+
+void CsvWriter::setParallel(bool parallel) {
+    KSL_PUBLIC(CsvWriter);
+    m->parallel = parallel;
+}
+
+
+bool CsvWriter::parallel() const {
+    KSL_PUBLIC(const CsvWriter);
+    return m->parallel;
+}
+
+
+qint64 CsvWriter::rowsWritten() const {
+    KSL_PUBLIC(const CsvWriter);
+    return m->rowsWritten;
+}
+
+
+qint64 CsvWriter::bytesWritten() const {
+    KSL_PUBLIC(const CsvWriter);
+    return m->bytesWritten + m->buffer.size();
+}
+
+
+bool CsvWriter::writeHeader(const QStringList &keys) {
+    KSL_PUBLIC(CsvWriter);
+    if (!m->file.isOpen())
+        return false;
+
+    QByteArray line;
+    line.resize(256);
+    char *pos = line.data();
+    for (int k=0; k<keys.size(); ++k) {
+        pos = CsvWriterPrivate::reserve(line, pos, 1);
+        if (k != 0)
+            *pos++ = m->delimiter;
+        pos = CsvWriterPrivate::writeText(line, pos, keys[k], m->delimiter);
+    }
+    pos = CsvWriterPrivate::reserve(line, pos, 1);
+    *pos++ = '\n';
+    line.resize(int(pos - line.constData()));
+    return m->append(line);
+}
+
+
+bool CsvWriter::write(const Array<1> &column) {
+    Array<2> rows(column.size(), 1);
+    std::copy(column.begin(), column.end(), rows[0]);
+    return write(rows);
+}
+
+
+bool CsvWriter::write(const Array<2> &rows) {
+    KSL_PUBLIC(CsvWriter);
+    if (!m->file.isOpen())
+        return false;
+    return m->writeBlocks(&CsvWriterPrivate::formatRows, &rows, rows.rows());
+}
+
+
+bool CsvWriter::write(const Csv &csv, bool header) {
+    KSL_PUBLIC(CsvWriter);
+    if (!m->file.isOpen())
+        return false;
+    if (header && !writeHeader(csv.keys()))
+        return false;
+
+    auto csvPriv = KSL_GET_PRIVATE(Csv, &csv);
+    CsvWriterPrivate::Table table;
+    table.columns = csvPriv->columns;
+    table.categories.resize(table.columns.size());
+    for (int j=0; j<table.columns.size(); ++j) {
+        const CsvPrivate::Column &column = table.columns[j];
+        if (column.type != Csv::Text || !column.encoded)
+            continue;
+        for (auto &category : column.categories) {
+            QByteArray cell;
+            cell.resize(category.size() + 2);
+            char *pos = CsvWriterPrivate::writeText(cell, cell.data(), category, m->delimiter);
+            cell.resize(int(pos - cell.constData()));
+            table.categories[j].append(cell);
+        }
+    }
+    return m->writeBlocks(&CsvWriterPrivate::formatColumns, &table, csvPriv->rows);
+}
+
+
+bool CsvWriter::flush() {
+    KSL_PUBLIC(CsvWriter);
+    if (!m->file.isOpen())
+        return false;
+    return m->writeBuffer() && m->file.flush();
+}
+
+
+char* CsvWriterPrivate::reserve(QByteArray &out, char *pos, int size) {
+    const int used = int(pos - out.constData());
+    if (out.size() - used < size) {
+        out.resize(qMax(2*out.size(), used + size));
+        pos = out.data() + used;
+    }
+    return pos;
+}
+
+
+char* CsvWriterPrivate::writeReal(char *pos, double x, char delimiter) {
+    // missing values are empty fields, unless an empty
+    // field would vanish between blank delimiters
+    if (x != x) {
+        if (CsvFields::isBlank(delimiter)) {
+            std::memcpy(pos, "nan", 3);
+            pos += 3;
+        }
+        return pos;
+    }
+    return pos + formatDouble(x, pos);
+}
+
+
+char* CsvWriterPrivate::writeRealField(char *pos, double x, char delimiter) {
+    char *begin = pos;
+    pos = writeReal(pos, x, delimiter);
+    // 18 would come back as an Integer column
+    if (std::memchr(begin, '.', pos - begin) == nullptr &&
+        std::memchr(begin, 'e', pos - begin) == nullptr &&
+        std::isfinite(x))
+    {
+        *pos++ = '.';
+        *pos++ = '0';
+    }
+    return pos;
+}
+
+
+char* CsvWriterPrivate::writeText(QByteArray &out, char *pos,
+                                  const QString &text, char delimiter)
+{
+    const QByteArray utf8 = text.toUtf8();
+    const char *begin = utf8.constData();
+    const char *end = begin + utf8.size();
+
+    // the reader trims blanks around fields and
+    // takes an empty field for a missing value
+    bool quote = (begin == end || CsvFields::isBlank(*begin)
+                  || CsvFields::isBlank(end[-1]));
+    for (const char *p = begin; p < end && !quote; ++p) {
+        const char c = *p;
+        quote = (c == delimiter || c == '"' || c == '#' || c == '\n' || c == '\r'
+                 || (CsvFields::isBlank(delimiter) && CsvFields::isBlank(c)));
+    }
+
+    if (!quote) {
+        pos = reserve(out, pos, utf8.size());
+        std::memcpy(pos, begin, utf8.size());
+        return pos + utf8.size();
+    }
+
+    pos = reserve(out, pos, 2*utf8.size() + 2);
+    *pos++ = '"';
+    for (const char *p = begin; p < end; ++p) {
+        if (*p == '"')
+            *pos++ = '"';
+        *pos++ = *p;
+    }
+    *pos++ = '"';
+    return pos;
+}
+
+
+QByteArray CsvWriterPrivate::formatRows(const Array<2> *rows, int begin,
+                                        int end, char delimiter)
+{
+    const int cols = rows->cols();
+    const int rowSize = cols*FormatBufferSize + 1;
+
+    QByteArray out;
+    out.resize((end - begin) * (12*cols + 1));
+    char *pos = out.data();
+    for (int i=begin; i<end; ++i) {
+        pos = reserve(out, pos, rowSize);
+        const double *row = (*rows)[i];
+        for (int j=0; j<cols; ++j) {
+            if (j != 0)
+                *pos++ = delimiter;
+            pos = writeReal(pos, row[j], delimiter);
+        }
+        *pos++ = '\n';
+    }
+    out.resize(int(pos - out.constData()));
+    return out;
+}
+
+
+QByteArray CsvWriterPrivate::formatColumns(const Table *table, int begin,
+                                           int end, char delimiter)
+{
+    const int cols = table->columns.size();
+    const int rowSize = cols*FormatBufferSize + 1;
+
+    QByteArray out;
+    out.resize((end - begin) * (12*cols + 1));
+    char *pos = out.data();
+    for (int i=begin; i<end; ++i) {
+        pos = reserve(out, pos, rowSize);
+        for (int j=0; j<cols; ++j) {
+            if (j != 0)
+                *pos++ = delimiter;
+            const CsvPrivate::Column &column = table->columns[j];
+            if (column.type == Csv::Integer) {
+                pos += formatInt(column.ints[i], pos);
+            }
+            else if (column.type == Csv::Real) {
+                pos = writeRealField(pos, column.reals[i], delimiter);
+            }
+            else if (column.encoded && column.codes[i] >= 0) {
+                const QByteArray &cell = table->categories[j][column.codes[i]];
+                pos = reserve(out, pos, cell.size() + rowSize);
+                std::memcpy(pos, cell.constData(), cell.size());
+                pos += cell.size();
+            }
+            else if (column.encoded) {
+                pos = writeText(out, pos, QString(), delimiter);
+                pos = reserve(out, pos, rowSize);
+            }
+            else {
+                pos = writeText(out, pos, column.texts[i], delimiter);
+                pos = reserve(out, pos, rowSize);
+            }
+        }
+        *pos++ = '\n';
+    }
+    out.resize(int(pos - out.constData()));
+    return out;
+}
+
+
+template <typename Source>
+bool CsvWriterPrivate::writeBlocks(QByteArray (*format)(const Source*, int, int, char),
+                                   const Source *source, int rows)
+{
+    bool ok = true;
+    int next = 0;
+
+    if (!parallel || rows < 2*BlockRows) {
+        while (ok && next < rows) {
+            int end = qMin(next + BlockRows, rows);
+            ok = append(format(source, next, end, delimiter));
+            next = end;
+        }
+        rowsWritten += next;
+        return ok;
+    }
+
+    // Keep a block per core being formatted while the
+    // finished ones are written in order
+    const int threads = qMax(QThread::idealThreadCount(), 1);
+    QList< QFuture<QByteArray> > pending;
+    QList<int> pendingRows;
+    while (next < rows || !pending.isEmpty()) {
+        while (ok && next < rows && pending.size() <= threads) {
+            int end = qMin(next + BlockRows, rows);
+            pending.append(QtConcurrent::run(format, source, next, end, delimiter));
+            pendingRows.append(end - next);
+            next = end;
+        }
+        QByteArray block = pending.takeFirst().result();
+        int blockRows = pendingRows.takeFirst();
+        if (ok && append(block))
+            rowsWritten += blockRows;
+        else
+            ok = false;
+    }
+    return ok;
+}
+
+
+bool CsvWriterPrivate::append(const QByteArray &text) {
+    if (buffer.size() + text.size() > BufferSize && !writeBuffer())
+        return false;
+
+    if (text.size() >= BufferSize) {
+        qint64 count = file.write(text);
+        bytesWritten += qMax(count, qint64(0));
+        return count == text.size();
+    }
+    buffer.append(text);
+    return true;
+}
+
+
+bool CsvWriterPrivate::writeBuffer() {
+    if (buffer.isEmpty())
+        return true;
+    qint64 count = file.write(buffer);
+    bytesWritten += qMax(count, qint64(0));
+    bool ok = (count == buffer.size());
+    buffer.clear();
+    return ok;
+}
+
+} // namespace Ksl
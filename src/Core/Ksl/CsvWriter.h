@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KSL_CSVWRITER_H
+#define KSL_CSVWRITER_H
+
+#include <Ksl/Object.h>
+#include <Ksl/Array.h>
+#include <QStringList>
+
+namespace Ksl {
+
+class Csv;
+
+// Writes delimited text files that Csv and CsvReader read back.
+// Numbers are written with formatDouble(), in text that converts
+// back to the same value. Rows are formatted in blocks, on all
+// cores when parallel is set, and the blocks go to the file in
+// large writes. Texts holding the delimiter, quotes, '#' or
+// newlines are quoted. NaN is written as an empty field, or as
+// nan when the delimiter is blank, since an empty field would
+// vanish there
+class KSL_EXPORT CsvWriter
+    : public Ksl::Object
+{
+public:
+
+    CsvWriter();
+
+    CsvWriter(const QString &filePath, char delimiter=' ');
+
+    // Flushes and closes the file
+    ~CsvWriter();
+
+
+    bool open(const QString &filePath, char delimiter=' ');
+
+    bool close();
+
+    bool isOpen() const;
+
+    void setParallel(bool parallel);
+
+    bool parallel() const;
+
+    qint64 rowsWritten() const;
+
+    qint64 bytesWritten() const;
+
+
+    bool writeHeader(const QStringList &keys);
+
+    // Writes the array as a single column
+    bool write(const Array<1> &column);
+
+    bool write(const Array<2> &rows);
+
+    // Writes all rows of csv, preceded by its keys if header is set
+    bool write(const Csv &csv, bool header=true);
+
+    // Writes the buffered text to the file
+    bool flush();
+};
+
+} // namespace Ksl
+
+#endif // KSL_CSVWRITER_H
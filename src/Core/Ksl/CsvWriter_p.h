@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the public Ksl API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed. Do not include it
+//
+// We mean it.
+//
+
+#ifndef KSL_CSVWRITER_P_H
+#define KSL_CSVWRITER_P_H
+
+#include <Ksl/CsvWriter.h>
+#include <Ksl/Csv_p.h>
+#include <QFile>
+
+namespace Ksl {
+
+class CsvWriterPrivate
+    : public Ksl::ObjectPrivate
+{
+public:
+
+    CsvWriterPrivate(CsvWriter *publ)
+        : Ksl::ObjectPrivate(publ)
+        , delimiter(' ')
+        , parallel(false)
+        , rowsWritten(0)
+        , bytesWritten(0)
+    { }
+
+
+    static const int BufferSize = 1 << 20;
+    static const int BlockRows = 1 << 14;
+
+    // Grows out, if needed, to have room for size
+    // more bytes after pos, and returns the new pos
+    static char* reserve(QByteArray &out, char *pos, int size);
+
+    static char* writeReal(char *pos, double x, char delimiter);
+    static char* writeRealField(char *pos, double x, char delimiter);
+    static char* writeText(QByteArray &out, char *pos,
+                           const QString &text, char delimiter);
+
+    static QByteArray formatRows(const Array<2> *rows, int begin,
+                                 int end, char delimiter);
+
+    // The columns of a Csv, with the categories
+    // of encoded ones already formatted
+    class Table
+    {
+    public:
+
+        QVector<CsvPrivate::Column> columns;
+        QVector< QVector<QByteArray> > categories;
+    };
+
+    static QByteArray formatColumns(const Table *table, int begin,
+                                    int end, char delimiter);
+
+    template <typename Source>
+    bool writeBlocks(QByteArray (*format)(const Source*, int, int, char),
+                     const Source *source, int rows);
+
+    bool append(const QByteArray &text);
+    bool writeBuffer();
+
+
+    char delimiter;
+    bool parallel;
+    QFile file;
+    QByteArray buffer;
+    qint64 rowsWritten;
+    qint64 bytesWritten;
+};
+
+} // namespace Ksl
+
+#endif // KSL_CSVWRITER_P_H
@@ -33,6 +33,8 @@
 #define QSL_CSV_P_H
 
 #include <Ksl/Csv.h>
+#include <QHash>
+#include <QMutex>
 
 namespace Ksl {
 
@@ -41,15 +43,159 @@ class CsvPrivate
 {
 public:
 
+    // Numeric columns are stored converted, the type of
+    // each column is promoted as the values are read. Text
+    // columns are kept as codes into a list of categories
+    // (-1 for missing values) until they have too many
+    // distinct values, then as one string per row
+    class Column
+    {
+    public:
+
+        Column()
+            : type(Csv::Integer)
+            , encoded(true)
+        { }
+
+        static const int CategoryLimit = 4096;
+
+        void append(const char *begin, const char *end, bool quoted=false);
+        void appendMissing();
+        void appendCategory(const char *begin, const char *end);
+        int intern(const QByteArray &text);
+        void releaseLookup();
+        void reserve(int size);
+        void toReal();
+        void toText();
+        void decode();
+
+        double real(int idx) const;
+        QString text(int idx) const;
+        Column select(const QVector<int> &rows) const;
+
+        Csv::ColumnType type;
+        Array<1,int> ints;
+        Array<1> reals;
+        QVector<QString> texts;
+
+        // Text columns while encoded. lookup is released once
+        // the file is parsed, and rebuilt if values are interned
+        // again
+        bool encoded;
+        Array<1,int> codes;
+        QStringList categories;
+        QHash<QByteArray,int> lookup;
+    };
+
+
+    // Columns parsed from one piece of a file
+    class Chunk
+    {
+    public:
+
+        Chunk()
+            : rows(0)
+        { }
+
+        QVector<Column> columns;
+        int rows;
+    };
+
+
+    // A row filter as set by the user
+    class RowFilter
+    {
+    public:
+
+        QString key;
+        int index;
+        std::function<bool(double)> accept;
+    };
+
+
+    // Which fields of a line are stored in which column, and
+    // which fields decide if the row is kept
+    class Projection
+    {
+    public:
+
+        Projection()
+            : cols(0)
+            , lastField(-1)
+            , identity(true)
+        { }
+
+        class Filter
+        {
+        public:
+
+            int field;
+            std::function<bool(double)> accept;
+        };
+
+        QVector<int> target;
+        QVector<Filter> filters;
+        int cols;
+        int lastField;
+        bool identity;
+    };
+
+
     CsvPrivate(Csv *publ)
         : Ksl::ObjectPrivate(publ)
         , empty(true)
+        , parallel(false)
+        , cached(false)
+        , rows(0)
     { }
 
+    void clear();
+    int indexOf(const QString &key) const;
+    void project(const QStringList &fileKeys);
+    void index();
+    void assign(const QStringList &newKeys,
+                const QVector<Column> &newColumns, int newRows);
+    void select();
+    bool readText(bool hasHeader, char delimiter);
+    bool readMapped(bool hasHeader, char delimiter);
+    void stitch(QVector<Chunk> &chunks);
+    bool readCached(bool hasHeader, char delimiter);
+    bool readSidecar(bool hasHeader, char delimiter);
+    bool writeSidecar(bool hasHeader, char delimiter) const;
+
+    // Columns reserve room for the rows guessed from the
+    // size of the first SampleRows lines
+    static const int SampleRows = 64;
+
+    static int guessRows(qint64 bytes, qint64 sampleBytes, int sampleRows);
+    static QString sidecarPath(const QString &filePath);
+
+    static bool parseLine(const char *begin, const char *end, char delimiter,
+                          const Projection &projection, Column *columns);
+    static Chunk parseChunk(const char *begin, const char *end,
+                            char delimiter, const Projection *projection);
+
+
     bool empty;
+    bool parallel;
+    bool cached;
+    int rows;
     QString filePath;
     QStringList keys;
-    QList< QVector<QString> > columns;
+    QHash<QString,int> keyIndex;
+    QVector<Column> columns;
+
+    // conversions done on request, by column index
+    mutable QMutex cacheMutex;
+    mutable QVector<bool> realCached;
+    mutable QVector<bool> textCached;
+    mutable QVector< Array<1> > realCache;
+    mutable QVector< QVector<QString> > textCache;
+
+    QStringList selectedKeys;
+    QVector<int> selectedIndexes;
+    QList<RowFilter> rowFilters;
+    Projection projection;
 };
 
 } // namespace Ksl
@@ -25,16 +25,57 @@
 
 namespace Ksl {
 
+// Evaluates the polynomial a[0] + a[1]*x + a[2]*x^2 + ...
+// at x using Horner's rule
 inline double poly(const Array<1> &a, double x) {
-    double f = 0.0;
-    double xn = 1.0;
-    for (int k=0; k<a.size(); ++k) {
-        f += a[k] * xn;
-        xn *= x;
-    }
+    int k = a.size() - 1;
+    if (k < 0)
+        return 0.0;
+    double f = a[k];
+    while (k-- > 0)
+        f = f*x + a[k];
     return f;
 }
 
+
+// Evaluates the polynomial at the n points in x storing the results
+// in y. Horner's rule is applied to a block of points at a time with
+// the loop over points innermost, so that the compiler vectorises it
+// and the block stays in cache across all the coefficients
+inline void polyval(const Array<1> &a, const double *x, double *y, int n) {
+    const int blockSize = 512;
+    const int deg = a.size() - 1;
+
+    if (deg < 0) {
+        for (int j=0; j<n; ++j)
+            y[j] = 0.0;
+        return;
+    }
+
+    const double *c = a.begin();
+    for (int i=0; i<n; i+=blockSize) {
+        const int m = (n-i < blockSize) ? n-i : blockSize;
+        const double *xb = x + i;
+        double *yb = y + i;
+
+        const double cn = c[deg];
+        for (int j=0; j<m; ++j)
+            yb[j] = cn;
+        for (int k=deg-1; k>=0; --k) {
+            const double ck = c[k];
+            for (int j=0; j<m; ++j)
+                yb[j] = yb[j]*xb[j] + ck;
+        }
+    }
+}
+
+
+inline Array<1> polyval(const Array<1> &a, const Array<1> &x) {
+    Array<1> y(x.size());
+    polyval(a, x.begin(), y.begin(), x.size());
+    return std::move(y);
+}
+
 } // namespace Ksl
 
 #endif // KSL_FUNCTIONS_H
@@ -21,7 +21,12 @@
 #ifndef KSL_GRAPH_H
 #define KSL_GRAPH_H
 
-#include <Ksl/MemoryPool.h>
+#include <Ksl/PoolAllocator.h>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace Ksl {
 
@@ -29,6 +34,8 @@ namespace Ksl {
 template <typename VertData, typename EdgeData> class GraphEdge;
 template <typename VertData, typename EdgeData> class GraphVertex;
 template <typename VertData, typename EdgeData> class Graph;
+template <typename VertData, typename EdgeData> class GraphIndex;
+template <typename VertData, typename EdgeData> class FrozenGraph;
 
 
 
@@ -85,9 +92,13 @@ public:
 
     typedef GraphEdge<VertData,EdgeData> TEdge;
     typedef Graph<VertData,EdgeData> TGraph;
+    typedef GraphIndex<VertData,EdgeData> TIndex;
 
     GraphVertex(const VertData &data)
         : m_edges(nullptr)
+        , m_index(nullptr)
+        , m_degree(0)
+        , m_id(0)
         , m_data(data)
     { }
 
@@ -97,8 +108,21 @@ public:
     TEdge *firstEdge() { return m_edges; }
     const TEdge *firstEdge() const { return m_edges; }
 
+    uint32_t degree() const { return m_degree; }
+
+    // Position of the vertex in its graph, from 0 for the
+    // entry, in order of addition
+    uint32_t id() const { return m_id; }
+
+    // Vertices with many edges may have a hash index, see
+    // Graph::setIndexDegree(). Otherwise the edge list is
+    // walked. Either way the newest match is found
+    bool indexed() const { return m_index != nullptr; }
+
 
     GraphVertex* findNeighbor(const VertData &neighborData) {
+        if (m_index != nullptr)
+            return m_index->findNeighbor(neighborData);
         auto edge = m_edges;
         while (edge != nullptr) {
             if (edge->target()->data() == neighborData)
@@ -109,6 +133,8 @@ public:
     }
 
     GraphVertex* findNeighborByEdge(const EdgeData &edgeData) {
+        if (m_index != nullptr)
+            return m_index->findNeighborByEdge(edgeData);
         auto edge = m_edges;
         while (edge != nullptr) {
             if (edge->data() == edgeData)
@@ -124,10 +150,88 @@ private:
     friend class Graph<VertData,EdgeData>;
 
     TEdge *m_edges;
+    TIndex *m_index;
+    uint32_t m_degree;
+    uint32_t m_id;
     VertData m_data;
 };
 
 
+// Finds the neighbors of one vertex by their data or by the data
+// of the edge leading to them. The index is kept up to date by
+// Graph::addNeighbor()
+template <
+    typename VertData,
+    typename EdgeData=VertData
+>
+class GraphIndex
+{
+public:
+
+    typedef GraphEdge<VertData,EdgeData> TEdge;
+    typedef GraphVertex<VertData,EdgeData> TVertex;
+
+    virtual ~GraphIndex() { }
+
+    virtual void insert(TEdge *edge) = 0;
+    virtual TVertex* findNeighbor(const VertData &neighborData) const = 0;
+    virtual TVertex* findNeighborByEdge(const EdgeData &edgeData) const = 0;
+};
+
+
+// A GraphIndex over two hash tables, drawing from a MemoryPool.
+// The data must be hashable with std::hash
+template <
+    typename VertData,
+    typename EdgeData=VertData
+>
+class GraphHashIndex
+    : public GraphIndex<VertData,EdgeData>
+{
+public:
+
+    typedef GraphEdge<VertData,EdgeData> TEdge;
+    typedef GraphVertex<VertData,EdgeData> TVertex;
+
+    GraphHashIndex(MemoryPool *pool, TVertex *vertex)
+        : m_byVertex(2*vertex->degree(), std::hash<VertData>(), std::equal_to<VertData>(),
+                     PoolAllocator< std::pair<const VertData,TVertex*> >(pool))
+        , m_byEdge(2*vertex->degree(), std::hash<EdgeData>(), std::equal_to<EdgeData>(),
+                   PoolAllocator< std::pair<const EdgeData,TVertex*> >(pool))
+    {
+        // the edge list starts with the newest edge, which
+        // is the one kept when data repeats
+        for (TEdge *edge=vertex->firstEdge(); edge!=nullptr; edge=edge->next()) {
+            m_byVertex.insert(std::make_pair(edge->target()->data(), edge->target()));
+            m_byEdge.insert(std::make_pair(edge->data(), edge->target()));
+        }
+    }
+
+    void insert(TEdge *edge) override {
+        m_byVertex[edge->target()->data()] = edge->target();
+        m_byEdge[edge->data()] = edge->target();
+    }
+
+    TVertex* findNeighbor(const VertData &neighborData) const override {
+        auto iter = m_byVertex.find(neighborData);
+        return iter != m_byVertex.end() ? iter->second : nullptr;
+    }
+
+    TVertex* findNeighborByEdge(const EdgeData &edgeData) const override {
+        auto iter = m_byEdge.find(edgeData);
+        return iter != m_byEdge.end() ? iter->second : nullptr;
+    }
+
+
+private:
+
+    std::unordered_map<VertData, TVertex*, std::hash<VertData>, std::equal_to<VertData>,
+                       PoolAllocator< std::pair<const VertData,TVertex*> > > m_byVertex;
+    std::unordered_map<EdgeData, TVertex*, std::hash<EdgeData>, std::equal_to<EdgeData>,
+                       PoolAllocator< std::pair<const EdgeData,TVertex*> > > m_byEdge;
+};
+
+
 // Base class for graph classes
 template <
     typename VertData,
@@ -139,35 +243,286 @@ public:
 
     typedef GraphEdge<VertData,EdgeData> TEdge;
     typedef GraphVertex<VertData,EdgeData> TVertex;
+    typedef GraphIndex<VertData,EdgeData> TIndex;
+    typedef FrozenGraph<VertData,EdgeData> TFrozen;
 
     Graph(MemoryPool *vertPool, MemoryPool *edgePool, const VertData &entryData)
         : m_vertPool(vertPool)
         , m_edgePool(edgePool)
+        , m_indexDegree(0)
+        , m_makeIndex(nullptr)
     {
-        m_entry = vertPool->alloc<TVertex>(entryData);
+        m_entry = vertex(addVertex(entryData));
     }
 
     TVertex* entry() { return m_entry; }
     const TVertex* entry() const { return m_entry; }
 
-    void addNeighbor(TVertex *vertex, const EdgeData &edgeData, const VertData &neighborData) {
-        auto neighbor = m_vertPool->alloc<TVertex>(neighborData);
-        auto edge = m_edgePool->alloc<TEdge>(vertex, neighbor, edgeData);
-        // prepend to edge list
-        edge->m_next = vertex->m_edges;
-        vertex->m_edges = edge;
+    uint32_t vertexCount() const { return uint32_t(m_vertices.size()); }
+
+    // The vertex of a given id, or nullptr
+    TVertex* vertex(uint32_t id) {
+        return id < m_vertices.size() ? m_vertices[id] : nullptr;
+    }
+
+    const TVertex* vertex(uint32_t id) const {
+        return id < m_vertices.size() ? m_vertices[id] : nullptr;
+    }
+
+    // Adds a vertex with no edges and returns its id
+    uint32_t addVertex(const VertData &data) {
+        auto vertex = m_vertPool->alloc<TVertex>(data);
+        vertex->m_id = uint32_t(m_vertices.size());
+        m_vertices.push_back(vertex);
+        return vertex->m_id;
     }
 
+    // Adds an edge between two vertices that are already there,
+    // returns nullptr if an id is not a vertex
+    TEdge* addEdge(uint32_t source, uint32_t target, const EdgeData &edgeData) {
+        if (source >= m_vertices.size() || target >= m_vertices.size())
+            return nullptr;
+        return link(m_vertices[source], m_vertices[target], edgeData);
+    }
+
+    // Adds a new vertex and an edge to it, returns the vertex
+    TVertex* addNeighbor(TVertex *vertex, const EdgeData &edgeData, const VertData &neighborData) {
+        auto neighbor = this->vertex(addVertex(neighborData));
+        link(vertex, neighbor, edgeData);
+        return neighbor;
+    }
+
+    // Vertices that reach minDegree edges get a GraphHashIndex,
+    // drawn from the edge pool, so that finding a neighbor
+    // takes constant time instead of a walk through the edge
+    // list. 0, the default, turns indexing off
+    void setIndexDegree(uint32_t minDegree) {
+        m_indexDegree = minDegree;
+        m_makeIndex = &Graph::makeHashIndex;
+    }
+
+    uint32_t indexDegree() const { return m_indexDegree; }
+
+    // A copy of the graph in compressed sparse row layout. The
+    // vertices keep their ids and the edges of each vertex keep
+    // the order of its edge list
+    TFrozen freeze() const;
 
 
 private:
 
+    TEdge* link(TVertex *vertex, TVertex *target, const EdgeData &edgeData) {
+        auto edge = m_edgePool->alloc<TEdge>(vertex, target, edgeData);
+        // prepend to edge list
+        edge->m_next = vertex->m_edges;
+        vertex->m_edges = edge;
+        vertex->m_degree += 1;
+
+        if (vertex->m_index != nullptr)
+            vertex->m_index->insert(edge);
+        else if (m_indexDegree > 0 && vertex->m_degree >= m_indexDegree)
+            vertex->m_index = m_makeIndex(m_edgePool, vertex);
+        return edge;
+    }
+
+    // Only used once indexing is turned on, so that graphs
+    // of data std::hash does not know still build
+    static TIndex* makeHashIndex(MemoryPool *pool, TVertex *vertex) {
+        return pool->alloc< GraphHashIndex<VertData,EdgeData> >(pool, vertex);
+    }
+
     MemoryPool *m_vertPool;
     MemoryPool *m_edgePool;
     TVertex *m_entry;
+    std::vector<TVertex*> m_vertices;
+    uint32_t m_indexDegree;
+    TIndex* (*m_makeIndex)(MemoryPool*, TVertex*);
+};
+
+
+// A graph that does not change, in compressed sparse row layout.
+// The edges of vertex v are the positions offsets[v] up to
+// offsets[v+1] of the targets and edge data arrays, so that a
+// traversal streams through memory instead of chasing pointers
+template <
+    typename VertData,
+    typename EdgeData=VertData
+>
+class FrozenGraph
+{
+public:
+
+    typedef uint32_t VertexId;
+
+    // The targets of the edges of one vertex
+    class Neighbors
+    {
+    public:
+
+        Neighbors(const VertexId *begin, const VertexId *end)
+            : m_begin(begin)
+            , m_end(end)
+        { }
+
+        const VertexId* begin() const { return m_begin; }
+        const VertexId* end() const { return m_end; }
+        uint32_t size() const { return uint32_t(m_end - m_begin); }
+
+    private:
+
+        const VertexId *m_begin;
+        const VertexId *m_end;
+    };
+
+
+    FrozenGraph()
+        : m_offsets(1, 0)
+    { }
+
+    // Takes over arrays that are already in layout. Empty data
+    // arrays are filled with default data
+    FrozenGraph(std::vector<uint64_t> offsets, std::vector<VertexId> targets,
+                std::vector<EdgeData> edgeData=std::vector<EdgeData>(),
+                std::vector<VertData> vertData=std::vector<VertData>())
+        : m_offsets(std::move(offsets))
+        , m_targets(std::move(targets))
+        , m_edgeData(std::move(edgeData))
+        , m_vertData(std::move(vertData))
+    {
+        if (m_offsets.empty())
+            m_offsets.push_back(0);
+        m_edgeData.resize(m_targets.size());
+        m_vertData.resize(m_offsets.size() - 1);
+    }
+
+    uint32_t vertexCount() const { return uint32_t(m_vertData.size()); }
+    uint64_t edgeCount() const { return m_targets.size(); }
+
+    VertData& data(VertexId vertex) { return m_vertData[vertex]; }
+    const VertData& data(VertexId vertex) const { return m_vertData[vertex]; }
+
+    uint32_t degree(VertexId vertex) const {
+        return uint32_t(m_offsets[vertex+1] - m_offsets[vertex]);
+    }
+
+    Neighbors neighbors(VertexId vertex) const {
+        const VertexId *targets = m_targets.data();
+        return Neighbors(targets + m_offsets[vertex], targets + m_offsets[vertex+1]);
+    }
+
+    // Data of the edges of vertex, in the order of neighbors()
+    const EdgeData* edgeData(VertexId vertex) const {
+        return m_edgeData.data() + m_offsets[vertex];
+    }
+
+    // The raw arrays, offsets has vertexCount()+1 entries
+    const uint64_t* offsets() const { return m_offsets.data(); }
+    const VertexId* targets() const { return m_targets.data(); }
+    const EdgeData* edgeData() const { return m_edgeData.data(); }
+
+
+    // Calls visit(vertex, depth) for the vertices reachable
+    // from source, in breadth-first order
+    template <typename Visit>
+    void bfs(VertexId source, Visit visit) const;
+
+    // Calls visit(vertex, depth) for the vertices reachable
+    // from source, in depth-first preorder
+    template <typename Visit>
+    void dfs(VertexId source, Visit visit) const;
+
+
+private:
+
+    friend class Graph<VertData,EdgeData>;
+
+    std::vector<uint64_t> m_offsets;
+    std::vector<VertexId> m_targets;
+    std::vector<EdgeData> m_edgeData;
+    std::vector<VertData> m_vertData;
 };
 
 
+template <typename VertData, typename EdgeData>
+FrozenGraph<VertData,EdgeData> Graph<VertData,EdgeData>::freeze() const {
+    TFrozen ret;
+    ret.m_offsets.reserve(m_vertices.size() + 1);
+    ret.m_vertData.reserve(m_vertices.size());
+    for (const TVertex *vertex : m_vertices) {
+        for (auto edge=vertex->firstEdge(); edge!=nullptr; edge=edge->next()) {
+            ret.m_targets.push_back(edge->target()->id());
+            ret.m_edgeData.push_back(edge->data());
+        }
+        ret.m_offsets.push_back(ret.m_targets.size());
+        ret.m_vertData.push_back(vertex->data());
+    }
+    return std::move(ret);
+}
+
+
+template <typename VertData, typename EdgeData>
+template <typename Visit>
+void FrozenGraph<VertData,EdgeData>::bfs(VertexId source, Visit visit) const {
+    const uint32_t count = vertexCount();
+    if (source >= count)
+        return;
+
+    std::vector<bool> seen(count, false);
+    std::vector<VertexId> queue;
+    queue.reserve(count);
+    queue.push_back(source);
+    seen[source] = true;
+
+    // the queue holds one level after the other
+    size_t levelEnd = 1;
+    uint32_t depth = 0;
+    for (size_t k=0; k<queue.size(); ++k) {
+        if (k == levelEnd) {
+            levelEnd = queue.size();
+            depth += 1;
+        }
+        const VertexId vertex = queue[k];
+        visit(vertex, depth);
+        for (VertexId target : neighbors(vertex)) {
+            if (!seen[target]) {
+                seen[target] = true;
+                queue.push_back(target);
+            }
+        }
+    }
+}
+
+
+template <typename VertData, typename EdgeData>
+template <typename Visit>
+void FrozenGraph<VertData,EdgeData>::dfs(VertexId source, Visit visit) const {
+    const uint32_t count = vertexCount();
+    if (source >= count)
+        return;
+
+    // each entry is a vertex and the next of its edges to follow
+    std::vector<bool> seen(count, false);
+    std::vector< std::pair<VertexId,uint64_t> > stack;
+    stack.push_back(std::make_pair(source, m_offsets[source]));
+    seen[source] = true;
+    visit(source, 0);
+
+    while (!stack.empty()) {
+        auto &top = stack.back();
+        if (top.second == m_offsets[top.first+1]) {
+            stack.pop_back();
+            continue;
+        }
+        const VertexId target = m_targets[top.second++];
+        if (!seen[target]) {
+            seen[target] = true;
+            visit(target, uint32_t(stack.size()));
+            stack.push_back(std::make_pair(target, m_offsets[target]));
+        }
+    }
+}
+
+
 } // namespace Ksl
 
 #endif // KSL_GRAPH_H
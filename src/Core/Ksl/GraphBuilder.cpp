@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Ksl/GraphBuilder_p.h>
+#include <QFuture>
+#include <QList>
+#include <QThread>
+#include <QtConcurrentRun>
+#include <QDebug>
+
+namespace Ksl {
+
+GraphBuilder::GraphBuilder()
+    : Ksl::Object(new GraphBuilderPrivate(this))
+{ }
+
+
+void GraphBuilder::setParallel(bool parallel) {
+    KSL_PUBLIC(GraphBuilder);
+    m->parallel = parallel;
+}
+
+
+bool GraphBuilder::parallel() const {
+    KSL_PUBLIC(const GraphBuilder);
+    return m->parallel;
+}
+
+
+void GraphBuilder::setSymmetric(bool symmetric) {
+    KSL_PUBLIC(GraphBuilder);
+    m->symmetric = symmetric;
+}
+
+
+bool GraphBuilder::symmetric() const {
+    KSL_PUBLIC(const GraphBuilder);
+    return m->symmetric;
+}
+
+
+bool GraphBuilder::build(const Array<1,int> &sources, const Array<1,int> &targets,
+                         uint32_t vertexCount)
+{
+    KSL_PUBLIC(GraphBuilder);
+    m->count = 0;
+    m->listSize = 0;
+    m->offsets.assign(1, 0);
+    m->targets.clear();
+    m->edgeIndex.clear();
+
+    if (sources.size() != targets.size()) {
+        qDebug() << "GraphBuilder::build: Edge lists differ in size!";
+        return false;
+    }
+
+    GraphBuilderPrivate::Job job;
+    job.sources = sources.begin();
+    job.targets = targets.begin();
+    job.listSize = uint32_t(sources.size());
+    job.edges = uint64_t(job.listSize) * (m->symmetric ? 2 : 1);
+    job.threads = 1;
+    if (m->parallel) {
+        job.threads = int(qMin(uint64_t(qMax(QThread::idealThreadCount(), 1)),
+                               qMax(job.edges / GraphBuilderPrivate::MinThreadEdges, uint64_t(1))));
+    }
+
+    // Check the ids and find the highest
+    job.highest.assign(job.threads, -1);
+    job.negative.assign(job.threads, 0);
+    GraphBuilderPrivate::forEach(&job, &GraphBuilderPrivate::scan);
+    int highest = -1;
+    for (int t=0; t<job.threads; ++t) {
+        if (job.negative[t]) {
+            qDebug() << "GraphBuilder::build: Negative vertex id!";
+            return false;
+        }
+        highest = qMax(highest, job.highest[t]);
+    }
+    if (vertexCount == 0)
+        vertexCount = uint32_t(highest + 1);
+    else if (highest >= 0 && uint32_t(highest) >= vertexCount) {
+        qDebug() << "GraphBuilder::build: Vertex id out of range!";
+        return false;
+    }
+    job.count = vertexCount;
+
+    // Counting sort by source. Each thread counts the edges of
+    // its part of the lists, the counts become the positions
+    // where each thread places them, in list order
+    m->offsets.assign(uint64_t(vertexCount) + 1, 0);
+    m->targets.resize(job.edges);
+    m->edgeIndex.resize(job.edges);
+    job.offsets = m->offsets.data();
+    job.outTargets = m->targets.data();
+    job.outIndex = m->edgeIndex.data();
+    job.counts.resize(job.threads);
+    GraphBuilderPrivate::forEach(&job, &GraphBuilderPrivate::tally);
+    GraphBuilderPrivate::forEach(&job, &GraphBuilderPrivate::sum);
+    for (uint32_t v=0; v<vertexCount; ++v)
+        m->offsets[v+1] += m->offsets[v];
+    GraphBuilderPrivate::forEach(&job, &GraphBuilderPrivate::place);
+
+    m->count = vertexCount;
+    m->listSize = job.listSize;
+    return true;
+}
+
+
+uint32_t GraphBuilder::vertexCount() const {
+    KSL_PUBLIC(const GraphBuilder);
+    return m->count;
+}
+
+
+uint64_t GraphBuilder::edgeCount() const {
+    KSL_PUBLIC(const GraphBuilder);
+    return m->targets.size();
+}
+
+
+const uint64_t* GraphBuilder::offsets() const {
+    KSL_PUBLIC(const GraphBuilder);
+    return m->offsets.data();
+}
+
+
+const uint32_t* GraphBuilder::targets() const {
+    KSL_PUBLIC(const GraphBuilder);
+    return m->targets.data();
+}
+
+
+const uint32_t* GraphBuilder::edgeIndex() const {
+    KSL_PUBLIC(const GraphBuilder);
+    return m->edgeIndex.data();
+}
+
+
+uint32_t GraphBuilder::listSize() const {
+    KSL_PUBLIC(const GraphBuilder);
+    return m->listSize;
+}
+
+
+void GraphBuilder::takeArrays(std::vector<uint64_t> &offsets, std::vector<uint32_t> &targets,
+                              std::vector<uint32_t> &edgeIndex)
+{
+    KSL_PUBLIC(GraphBuilder);
+    offsets.swap(m->offsets);
+    targets.swap(m->targets);
+    edgeIndex.swap(m->edgeIndex);
+    m->offsets.assign(1, 0);
+    m->targets.clear();
+    m->edgeIndex.clear();
+    m->count = 0;
+    m->listSize = 0;
+}
+
+
+void GraphBuilderPrivate::forEach(Job *job, void (*step)(Job*, int)) {
+    if (job->threads == 1) {
+        step(job, 0);
+        return;
+    }
+    QList< QFuture<void> > futures;
+    for (int t=0; t<job->threads; ++t)
+        futures.append(QtConcurrent::run(step, job, t));
+    for (auto &future : futures)
+        future.waitForFinished();
+}
+
+
+void GraphBuilderPrivate::scan(Job *job, int thread) {
+    // the opposite edges hold the same ids
+    const uint64_t end = qMin(job->begin(thread+1), uint64_t(job->listSize));
+    int highest = -1;
+    bool negative = false;
+    for (uint64_t k=job->begin(thread); k<end; ++k) {
+        const int source = job->sources[k];
+        const int target = job->targets[k];
+        negative = negative || source < 0 || target < 0;
+        highest = qMax(highest, qMax(source, target));
+    }
+    job->highest[thread] = highest;
+    job->negative[thread] = negative;
+}
+
+
+void GraphBuilderPrivate::tally(Job *job, int thread) {
+    std::vector<uint32_t> &counts = job->counts[thread];
+    counts.assign(job->count, 0);
+    const uint64_t end = job->begin(thread+1);
+    for (uint64_t k=job->begin(thread); k<end; ++k) {
+        const int source = k < job->listSize ? job->sources[k]
+                                             : job->targets[k - job->listSize];
+        counts[source] += 1;
+    }
+}
+
+
+void GraphBuilderPrivate::sum(Job *job, int thread) {
+    // each thread takes a range of vertices
+    const uint32_t first = uint32_t(uint64_t(job->count) * thread / job->threads);
+    const uint32_t last = uint32_t(uint64_t(job->count) * (thread+1) / job->threads);
+    for (uint32_t v=first; v<last; ++v) {
+        uint32_t total = 0;
+        for (int t=0; t<job->threads; ++t) {
+            const uint32_t count = job->counts[t][v];
+            job->counts[t][v] = total;
+            total += count;
+        }
+        job->offsets[v+1] = total;
+    }
+}
+
+
+void GraphBuilderPrivate::place(Job *job, int thread) {
+    std::vector<uint32_t> &next = job->counts[thread];
+    const uint64_t end = job->begin(thread+1);
+    for (uint64_t k=job->begin(thread); k<end; ++k) {
+        int source, target;
+        if (k < job->listSize) {
+            source = job->sources[k];
+            target = job->targets[k];
+        }
+        else {
+            source = job->targets[k - job->listSize];
+            target = job->sources[k - job->listSize];
+        }
+        const uint64_t at = job->offsets[source] + next[source]++;
+        job->outTargets[at] = uint32_t(target);
+        job->outIndex[at] = uint32_t(k);
+    }
+}
+
+} // namespace Ksl
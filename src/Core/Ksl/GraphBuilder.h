@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KSL_GRAPHBUILDER_H
+#define KSL_GRAPHBUILDER_H
+
+#include <Ksl/Array.h>
+#include <Ksl/Graph.h>
+#include <Ksl/Object.h>
+
+namespace Ksl {
+
+// Builds a graph in compressed sparse row layout from lists of
+// edges, like two integer columns of a Csv, sorting them by source
+// vertex with a counting sort. The edges of each vertex keep the
+// order of the lists
+class KSL_EXPORT GraphBuilder
+    : public Ksl::Object
+{
+public:
+
+    GraphBuilder();
+
+
+    // When set, the edges are counted and placed on all cores
+    void setParallel(bool parallel);
+
+    bool parallel() const;
+
+    // When set, every edge is also added in the opposite
+    // direction, after the edges of the lists
+    void setSymmetric(bool symmetric);
+
+    bool symmetric() const;
+
+
+    // Edge k goes from sources[k] to targets[k]. There are
+    // vertexCount vertices, or one more than the highest id if
+    // it is 0. Fails if the lists differ in size or hold an id
+    // that is negative or not a vertex
+    bool build(const Array<1,int> &sources, const Array<1,int> &targets,
+               uint32_t vertexCount=0);
+
+    uint32_t vertexCount() const;
+
+    uint64_t edgeCount() const;
+
+    // The layout as taken by Bfs and ShortestPath
+    const uint64_t* offsets() const;
+
+    const uint32_t* targets() const;
+
+    // Index in the lists of the edge at each position, or that
+    // plus the list size for the opposite edges
+    const uint32_t* edgeIndex() const;
+
+
+    // Moves the layout into a FrozenGraph, leaving the builder
+    // empty. The data of edge k of the lists is edgeData[k], the
+    // data of vertex v is vertData[v], when given
+    template <typename VertData, typename EdgeData>
+    FrozenGraph<VertData,EdgeData> take(const EdgeData *edgeData=nullptr,
+                                        const VertData *vertData=nullptr)
+    {
+        std::vector<uint64_t> offsets;
+        std::vector<uint32_t> targets, edgeIndex;
+        const uint32_t count = vertexCount();
+        const uint32_t listSize = this->listSize();
+        takeArrays(offsets, targets, edgeIndex);
+
+        std::vector<EdgeData> edges;
+        if (edgeData != nullptr) {
+            edges.reserve(targets.size());
+            for (uint32_t index : edgeIndex)
+                edges.push_back(edgeData[index < listSize ? index : index - listSize]);
+        }
+        std::vector<VertData> vertices;
+        if (vertData != nullptr)
+            vertices.assign(vertData, vertData + count);
+        return FrozenGraph<VertData,EdgeData>(std::move(offsets), std::move(targets),
+                                              std::move(edges), std::move(vertices));
+    }
+
+
+private:
+
+    uint32_t listSize() const;
+
+    void takeArrays(std::vector<uint64_t> &offsets, std::vector<uint32_t> &targets,
+                    std::vector<uint32_t> &edgeIndex);
+};
+
+} // namespace Ksl
+
+#endif // KSL_GRAPHBUILDER_H
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the public Ksl API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed. Do not include it
+//
+// We mean it.
+//
+
+
+#ifndef KSL_GRAPHBUILDER_P_H
+#define KSL_GRAPHBUILDER_P_H
+
+#include <Ksl/GraphBuilder.h>
+#include <vector>
+
+namespace Ksl {
+
+class GraphBuilderPrivate
+    : public Ksl::ObjectPrivate
+{
+public:
+
+    GraphBuilderPrivate(GraphBuilder *publ)
+        : Ksl::ObjectPrivate(publ)
+        , parallel(false)
+        , symmetric(false)
+        , count(0)
+        , listSize(0)
+        , offsets(1, 0)
+    { }
+
+    // Lists shorter than that are not split
+    static const uint32_t MinThreadEdges = 1 << 16;
+
+
+    // The state shared by the threads of a build. Edge k is
+    // sources[k] to targets[k] for k below listSize, and the
+    // opposite of edge k-listSize after that
+    class Job
+    {
+    public:
+
+        uint64_t begin(int thread) const { return edges * thread / threads; }
+
+        const int *sources;
+        const int *targets;
+        uint32_t listSize;
+        uint64_t edges;
+        uint32_t count;
+        int threads;
+
+        // edges of each vertex met by each thread, then the
+        // position of the next of them
+        std::vector< std::vector<uint32_t> > counts;
+        std::vector<int> highest;
+        std::vector<char> negative;
+
+        uint64_t *offsets;
+        uint32_t *outTargets;
+        uint32_t *outIndex;
+    };
+
+
+    static void scan(Job *job, int thread);
+    static void tally(Job *job, int thread);
+    static void sum(Job *job, int thread);
+    static void place(Job *job, int thread);
+    static void forEach(Job *job, void (*step)(Job*, int));
+
+
+    bool parallel;
+    bool symmetric;
+    uint32_t count;
+    uint32_t listSize;
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> targets;
+    std::vector<uint32_t> edgeIndex;
+};
+
+} // namespace Ksl
+
+#endif // KSL_GRAPHBUILDER_P_H
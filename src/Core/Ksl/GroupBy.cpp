@@ -0,0 +1,422 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Ksl/GroupBy_p.h>
+#include <Ksl/Csv_p.h>
+#include <QHash>
+#include <QThread>
+#include <QVarLengthArray>
+#include <QtConcurrentRun>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace Ksl {
+
+GroupBy::GroupBy()
+    : Ksl::Object(new GroupByPrivate(this))
+{ }
+
+
+GroupBy::GroupBy(const QStringList &keys)
+    : Ksl::Object(new GroupByPrivate(this))
+{
+    setKeys(keys);
+}
+
+
+void GroupBy::setKeys(const QStringList &keys) {
+    KSL_PUBLIC(GroupBy);
+    m->keys = keys;
+}
+
+
+QStringList GroupBy::keys() const {
+    KSL_PUBLIC(const GroupBy);
+    return m->keys;
+}
+
+
+void GroupBy::addAggregate(Aggregate func, const QString &column,
+                           const QString &name)
+{
+    KSL_PUBLIC(GroupBy);
+    static const char *const funcNames[] = {
+        "count", "sum", "mean", "min", "max", "var", "std"
+    };
+
+    GroupByPrivate::Spec spec;
+    spec.func = func;
+    spec.column = column;
+    spec.name = name;
+    if (name.isEmpty()) {
+        spec.name = QString::fromLatin1(funcNames[func]);
+        if (!column.isEmpty())
+            spec.name += "(" + column + ")";
+    }
+    m->specs.append(spec);
+}
+
+
+void GroupBy::clearAggregates() {
+    KSL_PUBLIC(GroupBy);
+    m->specs.clear();
+}
+
+
+void GroupBy::setParallel(bool parallel) {
+    KSL_PUBLIC(GroupBy);
+    m->parallel = parallel;
+}
+
+
+bool GroupBy::parallel() const {
+    KSL_PUBLIC(const GroupBy);
+    return m->parallel;
+}
+
+
+bool GroupBy::apply(const Csv &csv, Csv &result) const {
+    KSL_PUBLIC(const GroupBy);
+    auto source = KSL_GET_PRIVATE(Csv, &csv);
+    const int rows = source->rows;
+    const int keyCount = m->keys.size();
+    GroupByPrivate::Plan plan;
+
+    // Plain text keys get codes made up for them here,
+    // categorical ones already have theirs
+    QVector<int> keyColumns;
+    QVector<QStringList> categories(keyCount);
+    QVector< Array<1,int> > textCodes(keyCount);
+    for (int k=0; k<keyCount; ++k) {
+        int index = source->indexOf(m->keys[k]);
+        if (index < 0) {
+            qDebug() << "GroupBy::apply: No column" << m->keys[k];
+            return false;
+        }
+        const CsvPrivate::Column &column = source->columns[index];
+        GroupByPrivate::Plan::Key key;
+        if (column.type == Csv::Integer) {
+            key.ints = column.ints.begin();
+        }
+        else if (column.type == Csv::Real) {
+            key.reals = column.reals.begin();
+        }
+        else if (column.encoded) {
+            key.ints = column.codes.begin();
+            categories[k] = column.categories;
+        }
+        else {
+            textCodes[k] = GroupByPrivate::encode(column.texts, &categories[k]);
+            key.ints = textCodes[k].begin();
+        }
+        keyColumns.append(index);
+        plan.keys.append(key);
+    }
+
+    // Aggregates of the same column share its Accum
+    QStringList valueKeys;
+    QVector<int> specValues;
+    for (auto &spec : m->specs) {
+        int value = -1;
+        if (!spec.column.isEmpty()) {
+            int index = source->indexOf(spec.column);
+            if (index < 0) {
+                qDebug() << "GroupBy::apply: No column" << spec.column;
+                return false;
+            }
+            value = valueKeys.indexOf(spec.column);
+            if (value < 0) {
+                value = valueKeys.size();
+                valueKeys.append(spec.column);
+                plan.values.append(csv.array(index).begin());
+                plan.moments.append(false);
+            }
+            if (spec.func == Variance || spec.func == StdDev)
+                plan.moments[value] = true;
+        }
+        specValues.append(value);
+    }
+
+    GroupByPrivate::Table table;
+    int threads = 1;
+    if (m->parallel) {
+        threads = qMin(qMax(QThread::idealThreadCount(), 1),
+                       qMax(rows / GroupByPrivate::MinThreadRows, 1));
+    }
+    if (threads == 1) {
+        table = GroupByPrivate::aggregate(&plan, 0, rows);
+    }
+    else {
+        QList< QFuture<GroupByPrivate::Table> > futures;
+        for (int k=0; k<threads; ++k) {
+            int begin = int(qint64(rows) * k / threads);
+            int end = int(qint64(rows) * (k+1) / threads);
+            futures.append(QtConcurrent::run(
+                &GroupByPrivate::aggregate, &plan, begin, end));
+        }
+        // merging in row order keeps groups in order of appearance
+        table = futures.first().result();
+        for (int k=1; k<threads; ++k)
+            GroupByPrivate::merge(table, futures[k].result());
+    }
+
+    const int groups = table.groups;
+    const int valueCount = plan.values.size();
+    QStringList names;
+    QVector<CsvPrivate::Column> columns;
+    for (int k=0; k<keyCount; ++k) {
+        const CsvPrivate::Column &from = source->columns[keyColumns[k]];
+        CsvPrivate::Column column;
+        column.type = from.type;
+        if (from.type == Csv::Real) {
+            column.reals = Array<1>(groups);
+            for (int g=0; g<groups; ++g)
+                column.reals[g] = GroupByPrivate::real(table.words[g*keyCount + k]);
+        }
+        else {
+            Array<1,int> ints(groups);
+            for (int g=0; g<groups; ++g)
+                ints[g] = int(table.words[g*keyCount + k]);
+            if (from.type == Csv::Integer) {
+                column.ints = ints;
+            } else {
+                column.codes = ints;
+                column.categories = categories[k];
+            }
+        }
+        names.append(m->keys[k]);
+        columns.append(column);
+    }
+
+    for (int i=0; i<m->specs.size(); ++i) {
+        const GroupByPrivate::Spec &spec = m->specs[i];
+        const int value = specValues[i];
+        CsvPrivate::Column column;
+        if (spec.func == Count) {
+            column.ints = Array<1,int>(groups);
+            for (int g=0; g<groups; ++g) {
+                column.ints[g] = (value < 0) ? table.sizes[g]
+                    : int(table.accums[g*valueCount + value].count);
+            }
+        }
+        else {
+            column.type = Csv::Real;
+            column.reals = Array<1>(groups);
+            for (int g=0; g<groups; ++g)
+                column.reals[g] = table.accums[g*valueCount + value].result(spec.func);
+        }
+        names.append(spec.name);
+        columns.append(column);
+    }
+
+    KSL_GET_PRIVATE(Csv, &result)->assign(names, columns, groups);
+    return true;
+}
+
+
+Array<1,int> GroupByPrivate::encode(const QVector<QString> &texts,
+                                    QStringList *categories)
+{
+    Array<1,int> ret(texts.size());
+    QHash<QString,int> lookup;
+    for (int k=0; k<texts.size(); ++k) {
+        const QString &text = texts[k];
+        if (text.isNull()) {
+            ret[k] = -1;
+            continue;
+        }
+        int code = lookup.value(text, -1);
+        if (code < 0) {
+            code = categories->size();
+            lookup.insert(text, code);
+            categories->append(text);
+        }
+        ret[k] = code;
+    }
+    return std::move(ret);
+}
+
+
+quint64 GroupByPrivate::hash(const qint64 *keyWords, int count) {
+    quint64 h = Q_UINT64_C(0x9e3779b97f4a7c15);
+    for (int k=0; k<count; ++k) {
+        h ^= quint64(keyWords[k]);
+        h *= Q_UINT64_C(0xbf58476d1ce4e5b9);
+        h ^= h >> 31;
+    }
+    // the table takes the low bits
+    h ^= h >> 33;
+    h *= Q_UINT64_C(0xff51afd7ed558ccd);
+    h ^= h >> 33;
+    return h;
+}
+
+
+qint64 GroupByPrivate::word(double x) {
+    // all NaNs are one missing key, and -0 is 0
+    if (x != x)
+        x = std::numeric_limits<double>::quiet_NaN();
+    else if (x == 0.0)
+        x = 0.0;
+    qint64 ret;
+    std::memcpy(&ret, &x, sizeof(ret));
+    return ret;
+}
+
+
+double GroupByPrivate::real(qint64 word) {
+    double ret;
+    std::memcpy(&ret, &word, sizeof(ret));
+    return ret;
+}
+
+
+GroupByPrivate::Table GroupByPrivate::aggregate(const Plan *plan, int begin, int end) {
+    const int keyCount = plan->keys.size();
+    const int valueCount = plan->values.size();
+    const Plan::Key *keys = plan->keys.constData();
+    const double *const *values = plan->values.constData();
+    const QVector<bool> &moments = plan->moments;
+
+    Table table(keyCount, valueCount);
+    QVarLengthArray<qint64,8> keyWords(keyCount);
+    for (int row=begin; row<end; ++row) {
+        for (int k=0; k<keyCount; ++k) {
+            keyWords[k] = keys[k].ints ? qint64(keys[k].ints[row])
+                                       : word(keys[k].reals[row]);
+        }
+        int group = table.find(keyWords.constData(),
+                               hash(keyWords.constData(), keyCount));
+        table.sizes[group] += 1;
+        Accum *accums = table.accums.data() + group*valueCount;
+        for (int v=0; v<valueCount; ++v)
+            accums[v].add(values[v][row], moments[v]);
+    }
+    return std::move(table);
+}
+
+
+void GroupByPrivate::merge(Table &into, const Table &from) {
+    const int keyCount = from.keyCount;
+    const int valueCount = from.valueCount;
+    for (int g=0; g<from.groups; ++g) {
+        int group = into.find(from.words.constData() + g*keyCount, from.hashes[g]);
+        into.sizes[group] += from.sizes[g];
+        for (int v=0; v<valueCount; ++v)
+            into.accums[group*valueCount + v].merge(from.accums[g*valueCount + v]);
+    }
+}
+
+
+void GroupByPrivate::Accum::merge(const Accum &that) {
+    if (that.count == 0)
+        return;
+    if (count == 0) {
+        *this = that;
+        return;
+    }
+    // Chan et al. update of the moments
+    const qint64 total = count + that.count;
+    const double delta = that.mean - mean;
+    mean += delta * that.count / total;
+    m2 += that.m2 + delta * delta * count * that.count / total;
+    count = total;
+    sum += that.sum;
+    min = qMin(min, that.min);
+    max = qMax(max, that.max);
+}
+
+
+double GroupByPrivate::Accum::result(GroupBy::Aggregate func) const {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    switch (func) {
+    case GroupBy::Count:
+        return double(count);
+    case GroupBy::Sum:
+        return sum;
+    case GroupBy::Mean:
+        return count > 0 ? sum / count : nan;
+    case GroupBy::Min:
+        return count > 0 ? min : nan;
+    case GroupBy::Max:
+        return count > 0 ? max : nan;
+    case GroupBy::Variance:
+        return count > 1 ? m2 / (count - 1) : nan;
+    case GroupBy::StdDev:
+        return count > 1 ? std::sqrt(m2 / (count - 1)) : nan;
+    }
+    return nan;
+}
+
+
+GroupByPrivate::Table::Table(int keyCount, int valueCount)
+    : keyCount(keyCount)
+    , valueCount(valueCount)
+    , groups(0)
+    , mask(63)
+{
+    buckets.fill(-1, mask + 1);
+}
+
+
+int GroupByPrivate::Table::find(const qint64 *keyWords, quint64 hash) {
+    const int *bucketData = buckets.constData();
+    const qint64 *wordData = words.constData();
+    const quint64 *hashData = hashes.constData();
+    int bucket = int(hash) & mask;
+    for (;;) {
+        const int group = bucketData[bucket];
+        if (group < 0)
+            break;
+        if (hashData[group] == hash &&
+            std::equal(keyWords, keyWords + keyCount, wordData + group*keyCount))
+            return group;
+        bucket = (bucket + 1) & mask;
+    }
+
+    buckets[bucket] = groups;
+    for (int k=0; k<keyCount; ++k)
+        words.append(keyWords[k]);
+    hashes.append(hash);
+    sizes.append(0);
+    accums.resize(accums.size() + valueCount);
+
+    // keep the table at most half full
+    if (++groups * 2 > buckets.size())
+        grow();
+    return groups - 1;
+}
+
+
+void GroupByPrivate::Table::grow() {
+    buckets.fill(-1, 2 * buckets.size());
+    mask = buckets.size() - 1;
+    int *bucketData = buckets.data();
+    for (int g=0; g<groups; ++g) {
+        int bucket = int(hashes[g]) & mask;
+        while (bucketData[bucket] >= 0)
+            bucket = (bucket + 1) & mask;
+        bucketData[bucket] = g;
+    }
+}
+
+} // namespace Ksl
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KSL_GROUPBY_H
+#define KSL_GROUPBY_H
+
+#include <Ksl/Csv.h>
+
+namespace Ksl {
+
+// Aggregates the rows of a Csv that share the values of some key
+// columns. Missing values are skipped by the aggregates, while a
+// missing key is a key value like any other
+class KSL_EXPORT GroupBy
+    : public Ksl::Object
+{
+public:
+
+    enum Aggregate {
+        Count,
+        Sum,
+        Mean,
+        Min,
+        Max,
+        Variance,
+        StdDev
+    };
+
+
+    GroupBy();
+
+    GroupBy(const QStringList &keys);
+
+
+    void setKeys(const QStringList &keys);
+
+    QStringList keys() const;
+
+    // Adds a column to the result holding func of the values of
+    // column in each group, named name or "func(column)". Count
+    // with no column counts the rows of each group
+    void addAggregate(Aggregate func, const QString &column=QString(),
+                      const QString &name=QString());
+
+    void clearAggregates();
+
+    // When set, apply() aggregates parts of the rows on all
+    // cores and merges the partial results
+    void setParallel(bool parallel);
+
+    bool parallel() const;
+
+    // Fills result with one row per group, in the order the groups
+    // first appear in csv, holding the key columns followed by one
+    // column per aggregate. Key columns keep their type, counts are
+    // Integer and the other aggregates Real
+    bool apply(const Csv &csv, Csv &result) const;
+};
+
+} // namespace Ksl
+
+#endif // KSL_GROUPBY_H
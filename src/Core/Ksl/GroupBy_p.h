@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the public Ksl API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed. Do not include it
+//
+// We mean it.
+//
+
+#ifndef KSL_GROUPBY_P_H
+#define KSL_GROUPBY_P_H
+
+#include <Ksl/GroupBy.h>
+#include <QVector>
+#include <limits>
+
+namespace Ksl {
+
+class GroupByPrivate
+    : public Ksl::ObjectPrivate
+{
+public:
+
+    // An aggregate as added by the user
+    class Spec
+    {
+    public:
+
+        GroupBy::Aggregate func;
+        QString column;
+        QString name;
+    };
+
+
+    // Running aggregates of one value column in one group. The
+    // moments are only updated for Variance and StdDev
+    class Accum
+    {
+    public:
+
+        Accum()
+            : count(0)
+            , sum(0.0)
+            , min(std::numeric_limits<double>::infinity())
+            , max(-std::numeric_limits<double>::infinity())
+            , mean(0.0)
+            , m2(0.0)
+        { }
+
+        void add(double x, bool moments) {
+            if (x != x)
+                return;
+            ++count;
+            sum += x;
+            if (x < min) min = x;
+            if (x > max) max = x;
+            if (moments) {
+                double delta = x - mean;
+                mean += delta / count;
+                m2 += delta * (x - mean);
+            }
+        }
+
+        void merge(const Accum &that);
+        double result(GroupBy::Aggregate func) const;
+
+        qint64 count;
+        double sum;
+        double min;
+        double max;
+        double mean;
+        double m2;
+    };
+
+
+    // Where the workers read the rows from. Each key column
+    // gives a 64 bit word per row, from its integers, codes or
+    // the bits of its reals
+    class Plan
+    {
+    public:
+
+        class Key
+        {
+        public:
+
+            Key()
+                : ints(nullptr)
+                , reals(nullptr)
+            { }
+
+            const int *ints;
+            const double *reals;
+        };
+
+        QVector<Key> keys;
+        QVector<const double*> values;
+        QVector<bool> moments;
+    };
+
+
+    // The groups found in a range of rows, in an open addressing
+    // table with linear probing. Groups are numbered in the order
+    // they are first seen and keep their key words, hash, size
+    // and one Accum per value column
+    class Table
+    {
+    public:
+
+        Table(int keyCount=0, int valueCount=0);
+
+        // Returns the group of the given key words,
+        // adding it if it is new
+        int find(const qint64 *keyWords, quint64 hash);
+        void grow();
+
+        int keyCount;
+        int valueCount;
+        int groups;
+        int mask;
+        QVector<int> buckets;
+        QVector<qint64> words;
+        QVector<quint64> hashes;
+        QVector<int> sizes;
+        QVector<Accum> accums;
+    };
+
+
+    GroupByPrivate(GroupBy *publ)
+        : Ksl::ObjectPrivate(publ)
+        , parallel(false)
+    { }
+
+    static const int MinThreadRows = 1 << 16;
+
+    static Array<1,int> encode(const QVector<QString> &texts,
+                               QStringList *categories);
+    static quint64 hash(const qint64 *keyWords, int count);
+    static qint64 word(double x);
+    static double real(qint64 word);
+    static Table aggregate(const Plan *plan, int begin, int end);
+    static void merge(Table &into, const Table &from);
+
+
+    bool parallel;
+    QStringList keys;
+    QVector<Spec> specs;
+};
+
+} // namespace Ksl
+
+#endif // KSL_GROUPBY_P_H
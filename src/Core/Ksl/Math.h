@@ -26,18 +26,48 @@
 
 KSL_BEGIN_MATH_NAMESPACE
 
+// Compile time integer powers, computed by repeated squaring.
+// IntPow<N>::eval(x) expands into a fixed chain of products
+template <int N>
+struct IntPow {
+    static_assert(N >= 0, "Ksl::Math::pow<N> needs N >= 0");
+
+    template <typename T>
+    static constexpr T eval(const T &x) {
+        return (N % 2 == 0)
+            ? IntPow<N/2>::eval(x*x)
+            : x * IntPow<N/2>::eval(x*x);
+    }
+};
+
+template <>
+struct IntPow<1> {
+    template <typename T>
+    static constexpr T eval(const T &x) { return x; }
+};
+
+template <>
+struct IntPow<0> {
+    template <typename T>
+    static constexpr T eval(const T &) { return T(1); }
+};
+
+template <int N, typename T>
+inline constexpr T pow(const T &x) { return IntPow<N>::eval(x); }
+
+
 // A shortcut for fast integer powers
-template <typename T> inline T pow2(const T& x) { return x*x; }
-template <typename T> inline T pow3(const T& x) { return x*x*x; }
-template <typename T> inline T pow4(const T& x) { T p2=x*x; return p2*p2; }
-template <typename T> inline T pow5(const T& x) { T p2=x*x; return p2*p2*x; }
-template <typename T> inline T pow6(const T& x) { T p2=x*x; return p2*p2*p2; }
-template <typename T> inline T pow7(const T& x) { T p2=x*x; return p2*p2*p2*x; }
-template <typename T> inline T pow8(const T& x) { T p2=x*x; T p4=p2*p2; return p4*p4; }
-template <typename T> inline T pow9(const T& x) { T p3=x*x*x; return p3*p3*p3; }
-template <typename T> inline T pow10(const T& x) { T p2=x*x; T p4=p2*p2; return p4*p4*p2; }
-template <typename T> inline T pow11(const T& x) { T p3=x*x*x; T p4=p3*x; return p4*p4*p3; }
-template <typename T> inline T pow12(const T& x) { T p3=x*x*x; T p6=p3*p3; return p6*p6; }
+template <typename T> inline constexpr T pow2(const T& x) { return pow<2>(x); }
+template <typename T> inline constexpr T pow3(const T& x) { return pow<3>(x); }
+template <typename T> inline constexpr T pow4(const T& x) { return pow<4>(x); }
+template <typename T> inline constexpr T pow5(const T& x) { return pow<5>(x); }
+template <typename T> inline constexpr T pow6(const T& x) { return pow<6>(x); }
+template <typename T> inline constexpr T pow7(const T& x) { return pow<7>(x); }
+template <typename T> inline constexpr T pow8(const T& x) { return pow<8>(x); }
+template <typename T> inline constexpr T pow9(const T& x) { return pow<9>(x); }
+template <typename T> inline constexpr T pow10(const T& x) { return pow<10>(x); }
+template <typename T> inline constexpr T pow11(const T& x) { return pow<11>(x); }
+template <typename T> inline constexpr T pow12(const T& x) { return pow<12>(x); }
 
 
 // Under some condition the compiler fails to identify the
@@ -19,6 +19,12 @@
  */
 
 #include <Ksl/MemoryPool_p.h>
+#include <QDebug>
+#include <cstdlib>
+
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#endif
 
 KSL_BEGIN_NAMESPACE
 
@@ -26,53 +32,691 @@ MemoryPool::MemoryPool(uint64_t unitSize, uint32_t numUnits)
     : Ksl::Object(new MemoryPoolPrivate(this))
 {
     KSL_PUBLIC(MemoryPool);
-    m->unitSize = unitSize;
-    m->numUnits = numUnits;
-    m->unitsUsed = 1;
+    // units hold whole blocks of MinAlignment
+    m->unitSize = qMax(unitSize + MinAlignment - 1, uint64_t(MinAlignment)) & ~(MinAlignment - 1);
+    m->nextUnitSize = m->unitSize;
+    m->units.reserve(int(numUnits));
+
+    // the first unit is taken by the first allocation
+    m->unitEnd.store(nullptr);
+    m->pos.store(nullptr);
+}
+
+
+void MemoryPool::setConcurrent(bool concurrent) {
+    KSL_PUBLIC(MemoryPool);
+    m->concurrent = concurrent;
+}
+
+
+bool MemoryPool::concurrent() const {
+    KSL_PUBLIC(const MemoryPool);
+    return m->concurrent;
+}
+
+
+void MemoryPool::setHugePages(bool hugePages) {
+    KSL_PUBLIC(MemoryPool);
+    m->hugePages = hugePages;
+}
 
-    m->units = new char*[numUnits];
-    m->units[0] = new char[unitSize];
-    m->currUnit = m->units[0];
-    m->pos = m->currUnit;
+
+bool MemoryPool::hugePages() const {
+    KSL_PUBLIC(const MemoryPool);
+    return m->hugePages;
 }
 
 
-void* MemoryPool::allocBytes(uint64_t amount) {
+void* MemoryPool::allocBytes(uint64_t amount, uint64_t alignment) {
     KSL_PUBLIC(MemoryPool);
-    void *buffer;
 
-    // MemoryPool can not allocate buffers bigger than unitSize
+    if (alignment > MinAlignment) {
+        // blocks are aligned to MinAlignment, so there is room
+        // for the offset between the block and the aligned address
+        char *block = (char*) allocBytes(amount + alignment);
+        if (block == nullptr)
+            return nullptr;
+        uintptr_t aligned = (uintptr_t(block) + MinAlignment + alignment - 1) & ~uintptr_t(alignment - 1);
+        ((uint64_t*) aligned)[-1] = uint64_t(aligned - uintptr_t(block));
+        return (void*) aligned;
+    }
+
     if (amount > m->unitSize)
+        return m->allocLarge(amount);
+
+    const int sizeClass = MemoryPoolPrivate::sizeClass(amount);
+    if (m->concurrent)
+        return m->allocShared(sizeClass, amount);
+
+    // Reuse a freed block of the same class if there is one
+    const uint64_t size = m->blockSize(sizeClass);
+    MemoryPoolPrivate::FreeBlock *block = m->freeLists[sizeClass];
+    if (block != nullptr) {
+        m->freeLists[sizeClass] = block->next;
+        m->freeListBytes -= size;
+    }
+    else {
+        block = (MemoryPoolPrivate::FreeBlock*) m->carve(size);
+        if (block == nullptr)
+            return nullptr;
+    }
+    m->requestedBytes += amount;
+    m->usedBytes += size;
+    m->allocationCounts[sizeClass] += 1;
+    m->liveCounts[sizeClass] += 1;
+    m->updatePeak(m->usedBytes + m->largeBytes.load(std::memory_order_relaxed));
+    return block;
+}
+
+
+void MemoryPool::freeBytes(void *location, uint64_t size, uint64_t alignment) {
+    KSL_PUBLIC(MemoryPool);
+    if (location == nullptr)
+        return;
+
+    if (alignment > MinAlignment) {
+        uint64_t offset = ((uint64_t*) location)[-1];
+        freeBytes((char*) location - offset, size + alignment);
+        return;
+    }
+
+    if (size > m->unitSize) {
+        m->freeLarge(location, size);
+        return;
+    }
+
+    const int sizeClass = MemoryPoolPrivate::sizeClass(size);
+    if (m->concurrent) {
+        m->freeShared(location, sizeClass, size);
+        return;
+    }
+
+    const uint64_t blockSize = m->blockSize(sizeClass);
+    auto block = (MemoryPoolPrivate::FreeBlock*) location;
+    block->next = m->freeLists[sizeClass];
+    m->freeLists[sizeClass] = block;
+
+    m->requestedBytes -= size;
+    m->usedBytes -= blockSize;
+    m->freeListBytes += blockSize;
+    m->liveCounts[sizeClass] -= 1;
+}
+
+
+uint64_t MemoryPool::reservedBytes() const {
+    KSL_PUBLIC(const MemoryPool);
+    QMutexLocker lock(&m->unitMutex);
+    uint64_t reserved = 0;
+    for (const auto &unit : m->units)
+        reserved += unit.size;
+    for (auto iter=m->large.constBegin(); iter!=m->large.constEnd(); ++iter)
+        reserved += iter.value().size;
+    return reserved;
+}
+
+
+uint64_t MemoryPool::usedBytes() const {
+    KSL_PUBLIC(const MemoryPool);
+    const uint64_t large = m->largeBytes.load(std::memory_order_relaxed);
+    if (!m->concurrent)
+        return m->usedBytes + large;
+
+    QMutexLocker lock(&m->cacheMutex);
+    int64_t used = m->retiredUsedBytes;
+    for (auto cache : m->threadCaches)
+        used += cache->usedBytes.load(std::memory_order_relaxed);
+    return uint64_t(qMax(used, int64_t(0))) + large;
+}
+
+
+uint64_t MemoryPool::freeListBytes() const {
+    KSL_PUBLIC(const MemoryPool);
+    if (!m->concurrent)
+        return m->freeListBytes;
+
+    QMutexLocker lock(&m->cacheMutex);
+    int64_t cached = m->depotBytes.load(std::memory_order_relaxed);
+    for (auto cache : m->threadCaches)
+        cached += cache->cachedBytes.load(std::memory_order_relaxed);
+    return uint64_t(qMax(cached, int64_t(0)));
+}
+
+
+double MemoryPool::fragmentation() const {
+    KSL_PUBLIC(const MemoryPool);
+    uint64_t used = usedBytes();
+    uint64_t carved = used + freeListBytes();
+    if (carved == 0)
+        return 0.0;
+
+    int64_t requested = m->requestedBytes;
+    if (m->concurrent) {
+        QMutexLocker lock(&m->cacheMutex);
+        requested = m->retiredRequestedBytes;
+        for (auto cache : m->threadCaches)
+            requested += cache->requestedBytes.load(std::memory_order_relaxed);
+    }
+    requested += m->largeBytes.load(std::memory_order_relaxed);
+    return 1.0 - double(requested) / double(carved);
+}
+
+
+uint64_t MemoryPool::peakBytes() const {
+    KSL_PUBLIC(const MemoryPool);
+    return m->peakBytes.load(std::memory_order_relaxed);
+}
+
+
+int MemoryPool::unitCount() const {
+    KSL_PUBLIC(const MemoryPool);
+    QMutexLocker lock(&m->unitMutex);
+    return m->units.size();
+}
+
+
+int MemoryPool::largeCount() const {
+    KSL_PUBLIC(const MemoryPool);
+    QMutexLocker lock(&m->unitMutex);
+    return m->large.size();
+}
+
+
+int MemoryPool::sizeClassCount() const {
+    KSL_PUBLIC(const MemoryPool);
+    return MemoryPoolPrivate::sizeClass(m->unitSize) + 1;
+}
+
+
+uint64_t MemoryPool::sizeClassBytes(int sizeClass) const {
+    KSL_PUBLIC(const MemoryPool);
+    if (sizeClass < 0 || sizeClass >= sizeClassCount())
+        return 0;
+    return m->blockSize(sizeClass);
+}
+
+
+int64_t MemoryPool::liveBlocks(int sizeClass) const {
+    KSL_PUBLIC(const MemoryPool);
+    if (sizeClass < 0 || sizeClass >= sizeClassCount())
+        return 0;
+    if (!m->concurrent)
+        return m->liveCounts[sizeClass];
+
+    QMutexLocker lock(&m->cacheMutex);
+    int64_t live = m->retiredLiveCounts[sizeClass];
+    for (auto cache : m->threadCaches)
+        live += cache->liveCounts[sizeClass].load(std::memory_order_relaxed);
+    return live;
+}
+
+
+uint64_t MemoryPool::allocations(int sizeClass) const {
+    KSL_PUBLIC(const MemoryPool);
+    if (sizeClass < 0 || sizeClass >= sizeClassCount())
+        return 0;
+    if (!m->concurrent)
+        return m->allocationCounts[sizeClass];
+
+    QMutexLocker lock(&m->cacheMutex);
+    uint64_t count = m->retiredAllocationCounts[sizeClass];
+    for (auto cache : m->threadCaches)
+        count += cache->allocationCounts[sizeClass].load(std::memory_order_relaxed);
+    return count;
+}
+
+
+MemoryPool::Mark MemoryPool::mark() {
+    KSL_PUBLIC(MemoryPool);
+    Mark ret;
+    if (m->concurrent) {
+        qDebug() << "MemoryPool::mark: Not available in concurrent mode!";
+        return std::move(ret);
+    }
+
+    ret.unit = m->currentUnit;
+    ret.pos = m->pos.load(std::memory_order_relaxed);
+    ret.serial = m->largeSerial;
+    ret.requestedBytes = m->requestedBytes;
+    ret.usedBytes = m->usedBytes;
+    ret.largeBytes = m->largeBytes.load(std::memory_order_relaxed);
+    ret.freeListBytes = m->freeListBytes;
+
+    // The free lists are carved after the mark, which fits as
+    // there are no more classes than blocks of 16 bytes in a
+    // unit. Blocks freed after the mark start new lists
+    const int classes = m->usedClasses();
+    const uint64_t savedBytes = (classes * sizeof(MemoryPoolPrivate::SavedClass)
+                                 + MinAlignment - 1) & ~(MinAlignment - 1);
+    auto saved = (MemoryPoolPrivate::SavedClass*) m->carve(savedBytes);
+    if (saved == nullptr)
+        return std::move(ret);
+    for (int k=0; k<classes; ++k) {
+        saved[k].freeList = m->freeLists[k];
+        saved[k].liveCount = m->liveCounts[k];
+        m->freeLists[k] = nullptr;
+    }
+    m->freeListBytes = 0;
+    ret.saved = saved;
+    return std::move(ret);
+}
+
+
+void MemoryPool::rewind(const Mark &mark) {
+    KSL_PUBLIC(MemoryPool);
+    if (m->concurrent) {
+        qDebug() << "MemoryPool::rewind: Not available in concurrent mode!";
+        return;
+    }
+
+    if (mark.unit > m->currentUnit ||
+            (mark.unit == m->currentUnit && mark.pos > m->pos.load()))
+        return;
+
+    // back to the unit and position of the mark, with the free
+    // lists saved there. The blocks freed since are dropped
+    const int classes = m->usedClasses();
+    auto saved = (const MemoryPoolPrivate::SavedClass*) mark.saved;
+    for (int k=0; k<classes; ++k) {
+        m->freeLists[k] = saved ? saved[k].freeList : nullptr;
+        m->liveCounts[k] = saved ? saved[k].liveCount : 0;
+    }
+    m->freeListBytes = saved ? mark.freeListBytes : 0;
+    m->currentUnit = mark.unit;
+    if (mark.unit < 0) {
+        m->pos.store(nullptr);
+        m->unitEnd.store(nullptr);
+    }
+    else {
+        const MemoryPoolPrivate::Unit &unit = m->units[mark.unit];
+        m->pos.store(mark.pos);
+        m->unitEnd.store(unit.data + unit.size);
+    }
+    m->requestedBytes = mark.requestedBytes;
+    m->usedBytes = mark.usedBytes;
+
+    // large allocations made after the mark, if any
+    m->largeBytes = mark.largeBytes;
+    if (m->largeSerial == mark.serial)
+        return;
+    QVector<MemoryPoolPrivate::Unit> released;
+    for (auto iter=m->large.constBegin(); iter!=m->large.constEnd(); ++iter) {
+        if (iter.value().serial >= mark.serial)
+            released.append(iter.value());
+    }
+    for (const auto &unit : released) {
+        m->large.take(unit.data);
+        MemoryPoolPrivate::freeUnit(unit);
+    }
+    m->largeSerial = mark.serial;
+}
+
+
+void MemoryPool::reset() {
+    rewind(Mark());
+}
+
+
+int MemoryPoolPrivate::sizeClass(uint64_t amount) {
+    if (amount <= SmallLimit)
+        return amount ? int((amount - 1) / Granularity) : 0;
+
+    // the smallest power of two holding amount
+    int bits = 0;
+    for (uint64_t x=amount-1; x!=0; x>>=1)
+        ++bits;
+    return SmallClasses + bits - 9;
+}
+
+
+uint64_t MemoryPoolPrivate::blockSize(int sizeClass) const {
+    uint64_t size = (sizeClass < SmallClasses)
+        ? Granularity * (sizeClass + 1)
+        : uint64_t(1) << (sizeClass - SmallClasses + 9);
+    // every block of a class has the same size, the
+    // largest ones are cut to the size of a unit
+    return size < unitSize ? size : unitSize;
+}
+
+
+int MemoryPoolPrivate::magazineBlocks(uint64_t blockSize) const {
+    uint64_t blocks = qMin(uint64_t(MagazineBytes), unitSize) / blockSize;
+    return int(qBound(uint64_t(1), blocks, uint64_t(MagazineBlocks)));
+}
+
+
+void* MemoryPoolPrivate::carve(uint64_t amount) {
+    // Bump the position in the current unit. A null position
+    // means that another thread is putting in a new unit
+    for (;;) {
+        char *current = pos.load(std::memory_order_acquire);
+        if (current != nullptr) {
+            char *end = unitEnd.load(std::memory_order_acquire);
+            if (uint64_t(end - current) >= amount) {
+                if (pos.compare_exchange_weak(current, current + amount))
+                    return current;
+                continue;
+            }
+        }
+
+        // If there is not enought space in the current unit
+        // take the next, twice as big as the last one. The
+        // tail of the current unit is left unused
+        QMutexLocker lock(&unitMutex);
+        if (pos.load() != current)
+            continue;
+        Unit unit;
+        if (currentUnit + 1 < units.size()) {
+            unit = units[currentUnit + 1];
+        }
+        else {
+            unit = allocUnit(nextUnitSize);
+            if (unit.data == nullptr)
+                return nullptr;
+            units.append(unit);
+            nextUnitSize = qMin(2*nextUnitSize, qMax(unitSize, uint64_t(MemoryPool::MaxUnitSize)));
+        }
+        pos.store(nullptr);
+        currentUnit += 1;
+        unitEnd.store(unit.data + unit.size);
+        pos.store(unit.data, std::memory_order_release);
+    }
+}
+
+
+MemoryPoolPrivate::Unit MemoryPoolPrivate::allocUnit(uint64_t size) const {
+    Unit unit;
+    unit.size = size;
+#ifdef Q_OS_UNIX
+    if (hugePages) {
+        unit.size = (size + HugePageSize - 1) & ~(HugePageSize - 1);
+        void *data = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        // needs huge pages reserved by the system
+        data = mmap(nullptr, unit.size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+        if (data == MAP_FAILED) {
+            data = mmap(nullptr, unit.size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+            if (data != MAP_FAILED)
+                madvise(data, unit.size, MADV_HUGEPAGE);
+#endif
+        }
+        if (data != MAP_FAILED) {
+            unit.data = (char*) data;
+            unit.mapped = true;
+            return unit;
+        }
+        unit.size = size;
+    }
+#endif
+    unit.data = (char*) std::malloc(size);
+    return unit;
+}
+
+
+void MemoryPoolPrivate::freeUnit(const Unit &unit) {
+#ifdef Q_OS_UNIX
+    if (unit.mapped) {
+        munmap(unit.data, unit.size);
+        return;
+    }
+#endif
+    std::free(unit.data);
+}
+
+
+void* MemoryPoolPrivate::allocLarge(uint64_t amount) {
+    Unit unit = allocUnit(amount);
+    if (unit.data == nullptr)
         return nullptr;
+    QMutexLocker lock(&unitMutex);
+    unit.serial = largeSerial++;
+    large.insert(unit.data, unit);
+    largeBytes += amount;
+    if (concurrent)
+        updatePeak(carvedBytes.load(std::memory_order_relaxed)
+                   - depotBytes.load(std::memory_order_relaxed) + largeBytes.load());
+    else
+        updatePeak(usedBytes + largeBytes.load());
+    return unit.data;
+}
+
+
+void MemoryPoolPrivate::freeLarge(void *location, uint64_t amount) {
+    Unit unit;
+    {
+        QMutexLocker lock(&unitMutex);
+        unit = large.take((char*) location);
+        if (unit.data != nullptr)
+            largeBytes -= amount;
+    }
+    if (unit.data != nullptr)
+        freeUnit(unit);
+}
+
+
+// Taken by a pool detaching the caches of other threads and by
+// those caches when their thread ends, so that a cache never
+// sees its pool half destroyed
+static QMutex detachMutex;
+
 
-    // If there is space in the current unit, just update position
-    // of pointer and return the current possition
-    uint64_t available = uint64_t(m->currUnit) + m->unitSize - uint64_t(m->pos);
-    if (available >= amount) {
-        buffer = m->pos;
-        m->pos += amount;
-        return buffer;
+uint64_t MemoryPoolPrivate::nextSerial() {
+    static std::atomic<uint64_t> serials(0);
+    return serials.fetch_add(1) + 1;
+}
+
+
+MemoryPoolPrivate::~MemoryPoolPrivate() {
+    // The cache of this thread gives its blocks back while
+    // the units are still there. Caches that other threads
+    // still hold are detached, they are deleted with their
+    // thread, or when their storage slot is reused, without
+    // touching the pool
+    caches.setLocalData(nullptr);
+    {
+        QMutexLocker detachLock(&detachMutex);
+        QMutexLocker lock(&cacheMutex);
+        for (ThreadCache *cache : threadCaches)
+            cache->pool = nullptr;
+        threadCaches.clear();
+    }
+    for (const auto &unit : units)
+        freeUnit(unit);
+    for (auto iter=large.constBegin(); iter!=large.constEnd(); ++iter)
+        freeUnit(iter.value());
+}
+
+
+MemoryPoolPrivate::ThreadCache* MemoryPoolPrivate::threadCache() {
+    if (caches.hasLocalData()) {
+        ThreadCache *cache = caches.localData();
+        if (cache != nullptr && cache->poolSerial == serial)
+            return cache;
+    }
+    // setLocalData() deletes a cache left by a pool that is gone
+    auto cache = new ThreadCache(this);
+    caches.setLocalData(cache);
+    return cache;
+}
+
+
+void* MemoryPoolPrivate::allocShared(int sizeClass, uint64_t amount) {
+    ThreadCache *cache = threadCache();
+    Magazine *loaded = cache->loaded + sizeClass;
+    if (loaded->count == 0) {
+        Magazine *spare = cache->spare + sizeClass;
+        if (spare->count > 0)
+            std::swap(*loaded, *spare);
+        else
+            refill(cache, sizeClass);
+        if (loaded->count == 0)
+            return nullptr;
     }
 
-    // If there is not enought space in the current unit but
-    // there is other units, allocate the next
-    if (m->unitsUsed < m->numUnits) {
-        m->units[m->unitsUsed] = new char[m->unitSize];
-        m->currUnit = m->units[m->unitsUsed++];
-        buffer = m->currUnit;
-        m->pos = m->currUnit + amount;
-        return buffer;
+    const uint64_t size = blockSize(sizeClass);
+    FreeBlock *block = loaded->blocks;
+    loaded->blocks = block->next;
+    loaded->count -= 1;
+
+    // only this thread writes its counters
+    auto relaxed = std::memory_order_relaxed;
+    cache->requestedBytes.store(cache->requestedBytes.load(relaxed) + amount, relaxed);
+    cache->usedBytes.store(cache->usedBytes.load(relaxed) + size, relaxed);
+    cache->cachedBytes.store(cache->cachedBytes.load(relaxed) - size, relaxed);
+    cache->allocationCounts[sizeClass].store(cache->allocationCounts[sizeClass].load(relaxed) + 1, relaxed);
+    cache->liveCounts[sizeClass].store(cache->liveCounts[sizeClass].load(relaxed) + 1, relaxed);
+    return block;
+}
+
+
+void MemoryPoolPrivate::freeShared(void *location, int sizeClass, uint64_t amount) {
+    ThreadCache *cache = threadCache();
+    const uint64_t size = blockSize(sizeClass);
+    const int capacity = magazineBlocks(size);
+    Magazine *loaded = cache->loaded + sizeClass;
+    if (loaded->count == capacity) {
+        // a full spare goes to the depot, the full
+        // loaded magazine becomes the spare
+        Magazine *spare = cache->spare + sizeClass;
+        if (spare->count > 0) {
+            pushBatch(sizeClass, spare->blocks, spare->count * size);
+            auto relaxed = std::memory_order_relaxed;
+            cache->cachedBytes.store(cache->cachedBytes.load(relaxed)
+                                     - spare->count * size, relaxed);
+        }
+        *spare = *loaded;
+        *loaded = Magazine();
+    }
+
+    auto block = (FreeBlock*) location;
+    block->next = loaded->blocks;
+    loaded->blocks = block;
+    loaded->count += 1;
+
+    auto relaxed = std::memory_order_relaxed;
+    cache->requestedBytes.store(cache->requestedBytes.load(relaxed) - amount, relaxed);
+    cache->usedBytes.store(cache->usedBytes.load(relaxed) - size, relaxed);
+    cache->cachedBytes.store(cache->cachedBytes.load(relaxed) + size, relaxed);
+    cache->liveCounts[sizeClass].store(cache->liveCounts[sizeClass].load(relaxed) - 1, relaxed);
+}
+
+
+void MemoryPoolPrivate::refill(ThreadCache *cache, int sizeClass) {
+    Magazine *loaded = cache->loaded + sizeClass;
+    const uint64_t size = blockSize(sizeClass);
+    auto relaxed = std::memory_order_relaxed;
+
+    FreeBlock *batch = popBatch(sizeClass);
+    if (batch != nullptr) {
+        int count = 0;
+        for (FreeBlock *block=batch; block!=nullptr; block=block->next)
+            ++count;
+        depotBytes.fetch_sub(count * size, relaxed);
+        loaded->blocks = batch;
+        loaded->count = count;
+        cache->cachedBytes.store(cache->cachedBytes.load(relaxed) + count * size, relaxed);
+        updatePeak(carvedBytes.load(relaxed) - depotBytes.load(relaxed)
+                   + largeBytes.load(relaxed));
+        return;
     }
 
-    // No way to return memory
+    // Carve a magazine worth of blocks in one go
+    int count = magazineBlocks(size);
+    char *blocks = (char*) carve(count * size);
+    if (blocks == nullptr) {
+        count = 1;
+        blocks = (char*) carve(size);
+        if (blocks == nullptr)
+            return;
+    }
+    for (int k=count-1; k>=0; --k) {
+        auto block = (FreeBlock*) (blocks + k*size);
+        block->next = loaded->blocks;
+        loaded->blocks = block;
+    }
+    loaded->count = count;
+    cache->cachedBytes.store(cache->cachedBytes.load(relaxed) + count * size, relaxed);
+    carvedBytes.fetch_add(count * size, relaxed);
+    updatePeak(carvedBytes.load(relaxed) - depotBytes.load(relaxed)
+               + largeBytes.load(relaxed));
+}
+
+
+void MemoryPoolPrivate::updatePeak(uint64_t bytes) {
+    uint64_t peak = peakBytes.load(std::memory_order_relaxed);
+    while (bytes > peak && !peakBytes.compare_exchange_weak(
+               peak, bytes, std::memory_order_relaxed))
+        ;
+}
+
+
+void MemoryPoolPrivate::pushBatch(int sizeClass, FreeBlock *batch, uint64_t bytes) {
+    depotBytes.fetch_add(bytes, std::memory_order_relaxed);
+    uint64_t head = depots[sizeClass].load(std::memory_order_relaxed);
+    do {
+        batch->nextBatch = batchOf(head);
+    } while (!depots[sizeClass].compare_exchange_weak(
+                 head, pack(batch, head),
+                 std::memory_order_release, std::memory_order_relaxed));
+}
+
+
+MemoryPoolPrivate::FreeBlock* MemoryPoolPrivate::popBatch(int sizeClass) {
+    // units are only released with the pool, so reading the
+    // link of a magazine that another thread took is harmless,
+    // the counter makes the compare-and-swap fail
+    uint64_t head = depots[sizeClass].load(std::memory_order_acquire);
+    while (FreeBlock *batch = batchOf(head)) {
+        if (depots[sizeClass].compare_exchange_weak(
+                head, pack(batch->nextBatch, head),
+                std::memory_order_acquire, std::memory_order_acquire))
+            return batch;
+    }
     return nullptr;
 }
 
 
-void MemoryPool::freeBytes(void *location, uint64_t size) {
-    // TODO
-    Q_UNUSED(location)
-    Q_UNUSED(size)
+MemoryPoolPrivate::ThreadCache::ThreadCache(MemoryPoolPrivate *pool)
+    : pool(pool)
+    , poolSerial(pool->serial)
+    , requestedBytes(0)
+    , usedBytes(0)
+    , cachedBytes(0)
+{
+    for (int k=0; k<ClassCount; ++k) {
+        allocationCounts[k].store(0);
+        liveCounts[k].store(0);
+    }
+    QMutexLocker lock(&pool->cacheMutex);
+    pool->threadCaches.append(this);
+}
+
+
+MemoryPoolPrivate::ThreadCache::~ThreadCache() {
+    // the magazines point into units that may be freed
+    QMutexLocker detachLock(&detachMutex);
+    if (pool == nullptr)
+        return;
+
+    for (int k=0; k<ClassCount; ++k) {
+        const uint64_t size = pool->blockSize(k);
+        for (Magazine *magazine : { loaded + k, spare + k }) {
+            if (magazine->count > 0)
+                pool->pushBatch(k, magazine->blocks, magazine->count * size);
+        }
+    }
+
+    QMutexLocker lock(&pool->cacheMutex);
+    pool->threadCaches.removeOne(this);
+    pool->retiredRequestedBytes += requestedBytes.load();
+    pool->retiredUsedBytes += usedBytes.load();
+    for (int k=0; k<ClassCount; ++k) {
+        pool->retiredAllocationCounts[k] += allocationCounts[k].load();
+        pool->retiredLiveCounts[k] += liveCounts[k].load();
+    }
 }
 
 KSL_END_NAMESPACE
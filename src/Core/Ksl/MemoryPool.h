@@ -26,38 +26,186 @@
 
 namespace Ksl {
 
+// Hands out blocks carved from units taken from the system. The
+// first unit has unitSize bytes and each new one is twice as big
+// as the last, up to MaxUnitSize, with no limit on their number.
+// Freed blocks go to a free list for their size class and are
+// handed out again before new memory is carved, so the size given
+// to freeBytes() must be the one given to allocBytes(). Requests
+// larger than unitSize get an allocation of their own, given back
+// to the system when freed. All memory goes with the pool
 class KSL_EXPORT MemoryPool
     : public Ksl::Object
 {
 public:
 
+    // numUnits is only a hint of how many units will be needed
     MemoryPool(uint64_t unitSize=1024, uint32_t numUnits=32);
 
+    static const uint64_t MaxUnitSize = uint64_t(1) << 30;
 
-    void* allocBytes(uint64_t amount);
+    // Every block is aligned to at least MinAlignment bytes
+    static const uint64_t MinAlignment = 16;
 
-    void freeBytes(void *location, uint64_t size);
+
+    // Stricter alignments (a power of two) are met by taking
+    // a larger block and keeping the offset to its start just
+    // before the aligned address, so the same alignment must
+    // be given to freeBytes()
+    void* allocBytes(uint64_t amount, uint64_t alignment=MinAlignment);
+
+    void freeBytes(void *location, uint64_t size, uint64_t alignment=MinAlignment);
+
+
+    // When set, allocBytes() and freeBytes() may be called from
+    // any thread, and blocks may be freed by a thread other than
+    // the one that allocated them. Each thread keeps magazines of
+    // free blocks per size class, refilled from a lock-free depot
+    // of magazines freed by the others or carved from the current
+    // unit with a compare-and-swap. Set it before the first
+    // allocation
+    void setConcurrent(bool concurrent);
+
+    bool concurrent() const;
+
+
+    // When set, units and large allocations are backed by huge
+    // pages where the system has them (MAP_HUGETLB, or transparent
+    // huge pages through madvise()), which cuts TLB misses when
+    // the pool grows large. They are then rounded up to 2 MiB.
+    // Set it before the first allocation
+    void setHugePages(bool hugePages);
+
+    bool hugePages() const;
+
+
+    // A point in the life of the pool that rewind() goes back to.
+    // The free lists and block counts at the mark are saved in
+    // the pool, right after the mark
+    class Mark
+    {
+    public:
+
+        Mark()
+            : unit(-1)
+            , pos(nullptr)
+            , serial(0)
+            , requestedBytes(0)
+            , usedBytes(0)
+            , largeBytes(0)
+            , freeListBytes(0)
+            , saved(nullptr)
+        { }
+
+        int unit;
+        char *pos;
+        uint64_t serial;
+        uint64_t requestedBytes;
+        uint64_t usedBytes;
+        uint64_t largeBytes;
+        uint64_t freeListBytes;
+        void *saved;
+    };
+
+    // Releases in one go the blocks handed out after the
+    // mark was taken, and the large allocations. Units stay
+    // with the pool to be carved again. The blocks in the free
+    // lists at the mark are set aside until the rewind gives
+    // them back, blocks from before the mark must not be freed
+    // in between. Only available in the sequential mode, marks
+    // are undone by earlier rewinds
+    Mark mark();
+
+    void rewind(const Mark &mark);
+
+    // Rewinds to the empty pool
+    void reset();
+
+
+    // Takes a mark on construction and rewinds to it on
+    // destruction, so that blocks allocated in a loop body or
+    // a paint frame cost nothing to free
+    class Scope
+    {
+    public:
+
+        Scope(MemoryPool *pool)
+            : m_pool(pool)
+            , m_mark(pool->mark())
+        { }
+
+        ~Scope() {
+            m_pool->rewind(m_mark);
+        }
+
+    private:
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        MemoryPool *m_pool;
+        Mark m_mark;
+    };
 
 
     template <typename T, typename... Args>
     inline T* alloc(Args... args) {
-        return new (allocBytes(sizeof(T))) T(args...);
+        void *ptr = allocBytes(sizeof(T), alignof(T));
+        return ptr ? new (ptr) T(args...) : nullptr;
     }
 
     template <typename T>
-    inline T* allocArray(uint64_t size) {
-        return (T*) allocBytes(size*sizeof(T));
+    inline T* allocArray(uint64_t size, uint64_t alignment=alignof(T)) {
+        return (T*) allocBytes(size*sizeof(T), alignment);
     }
 
     template <typename T>
     inline void free(T *ptr) {
-        freeBytes(ptr, sizeof(T));
+        ptr->~T();
+        freeBytes(ptr, sizeof(T), alignof(T));
     }
 
     template <typename T>
-    inline void freeArray(T *ptr, uint64_t size) {
-        freeBytes(ptr, size*sizeof(T));
+    inline void freeArray(T *ptr, uint64_t size, uint64_t alignment=alignof(T)) {
+        freeBytes(ptr, size*sizeof(T), alignment);
     }
+
+
+    // Bytes of the units and large allocations taken from the system
+    uint64_t reservedBytes() const;
+
+    // Bytes of the blocks handed out and not freed, which are
+    // rounded up to the size of their class, and of the large
+    // allocations
+    uint64_t usedBytes() const;
+
+    // Bytes of the blocks waiting in the free lists
+    uint64_t freeListBytes() const;
+
+    // Share of the carved bytes that is not holding live data,
+    // either waiting in the free lists or lost to rounding
+    double fragmentation() const;
+
+    // Most bytes in use at once. In the concurrent mode it counts
+    // the blocks held by the threads, in use or not, so it is
+    // higher by at most their magazines
+    uint64_t peakBytes() const;
+
+    // Units and large allocations taken from the system
+    int unitCount() const;
+
+    int largeCount() const;
+
+    // Blocks are handed out in sizeClassCount() classes, from
+    // 0 for the smallest, each with blocks of sizeClassBytes()
+    int sizeClassCount() const;
+
+    uint64_t sizeClassBytes(int sizeClass) const;
+
+    // Blocks of a class in use, and how many were ever handed out
+    int64_t liveBlocks(int sizeClass) const;
+
+    uint64_t allocations(int sizeClass) const;
 };
 
 } // namespace Ksl
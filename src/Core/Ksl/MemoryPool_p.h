@@ -33,6 +33,12 @@
 #define KSL_MEMORYPOOL_P_H
 
 #include <Ksl/MemoryPool.h>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QVector>
+#include <QThreadStorage>
+#include <atomic>
 
 namespace Ksl {
 
@@ -41,17 +47,213 @@ class MemoryPoolPrivate
 {
 public:
 
+    // Sizes up to SmallLimit are rounded up to a multiple of
+    // Granularity, larger ones to a power of two
+    static const uint64_t Granularity = 16;
+    static const uint64_t SmallLimit = 256;
+    static const int SmallClasses = int(SmallLimit / Granularity);
+    static const int ClassCount = SmallClasses + 55;
+
+    // Magazines hold about MagazineBytes, and at most
+    // MagazineBlocks blocks
+    static const uint64_t MagazineBytes = 2048;
+    static const int MagazineBlocks = 64;
+
+
+    // A freed block, linked through its first bytes. The first
+    // block of a magazine in the depot also links the next one
+    class FreeBlock
+    {
+    public:
+
+        FreeBlock *next;
+        FreeBlock *nextBatch;
+    };
+
+
+    // Memory taken from the system, either a unit or a large
+    // allocation. mapped tells it came from mmap(), serial
+    // orders the large allocations for rewind()
+    class Unit
+    {
+    public:
+
+        Unit()
+            : data(nullptr)
+            , size(0)
+            , mapped(false)
+            , serial(0)
+        { }
+
+        char *data;
+        uint64_t size;
+        bool mapped;
+        uint64_t serial;
+    };
+
+
+    // The free list and live blocks of a size class when a
+    // mark was taken
+    class SavedClass
+    {
+    public:
+
+        FreeBlock *freeList;
+        int64_t liveCount;
+    };
+
+
+    // Free blocks of one size class held by one thread
+    class Magazine
+    {
+    public:
+
+        Magazine()
+            : blocks(nullptr)
+            , count(0)
+        { }
+
+        FreeBlock *blocks;
+        int count;
+    };
+
+
+    // What a thread keeps of a concurrent pool: a loaded and a
+    // spare magazine per size class, and its share of the
+    // statistics. Only the owner thread writes the counters,
+    // relaxed atomics let the others read them. pool is null
+    // once the pool is gone, poolSerial tells which pool the
+    // cache was made for
+    class ThreadCache
+    {
+    public:
+
+        ThreadCache(MemoryPoolPrivate *pool);
+
+        // Gives the blocks back to the depot, unless the
+        // pool is gone
+        ~ThreadCache();
+
+        MemoryPoolPrivate *pool;
+        uint64_t poolSerial;
+        Magazine loaded[ClassCount];
+        Magazine spare[ClassCount];
+        std::atomic<int64_t> requestedBytes;
+        std::atomic<int64_t> usedBytes;
+        std::atomic<int64_t> cachedBytes;
+        std::atomic<uint64_t> allocationCounts[ClassCount];
+        std::atomic<int64_t> liveCounts[ClassCount];
+    };
+
+
     MemoryPoolPrivate(MemoryPool *publ)
         : Ksl::ObjectPrivate(publ)
-    { }
+        , nextUnitSize(0)
+        , currentUnit(-1)
+        , largeSerial(0)
+        , largeBytes(0)
+        , hugePages(false)
+        , concurrent(false)
+        , requestedBytes(0)
+        , usedBytes(0)
+        , freeListBytes(0)
+        , peakBytes(0)
+        , depotBytes(0)
+        , carvedBytes(0)
+        , retiredRequestedBytes(0)
+        , retiredUsedBytes(0)
+        , serial(nextSerial())
+    {
+        for (int k=0; k<ClassCount; ++k) {
+            freeLists[k] = nullptr;
+            allocationCounts[k] = 0;
+            liveCounts[k] = 0;
+            depots[k].store(0);
+            retiredAllocationCounts[k] = 0;
+            retiredLiveCounts[k] = 0;
+        }
+    }
+
+    // Gives all units and large allocations back
+    ~MemoryPoolPrivate();
+
+    static const uint64_t HugePageSize = uint64_t(1) << 21;
+
+    static uint64_t nextSerial();
+    static int sizeClass(uint64_t amount);
+    int usedClasses() const { return sizeClass(unitSize) + 1; }
+    uint64_t blockSize(int sizeClass) const;
+    int magazineBlocks(uint64_t blockSize) const;
+    void* carve(uint64_t amount);
+    void updatePeak(uint64_t bytes);
+    Unit allocUnit(uint64_t size) const;
+    static void freeUnit(const Unit &unit);
+    void* allocLarge(uint64_t amount);
+    void freeLarge(void *location, uint64_t amount);
 
+    ThreadCache* threadCache();
+    void* allocShared(int sizeClass, uint64_t amount);
+    void freeShared(void *location, int sizeClass, uint64_t amount);
+    void refill(ThreadCache *cache, int sizeClass);
+    void pushBatch(int sizeClass, FreeBlock *batch, uint64_t bytes);
+    FreeBlock* popBatch(int sizeClass);
 
+    // Depot heads keep a counter in the bits above the pointer
+    static const uint64_t PointerMask = (sizeof(void*) == 8)
+        ? Q_UINT64_C(0x0000ffffffffffff) : Q_UINT64_C(0xffffffff);
+
+    static FreeBlock* batchOf(uint64_t head) {
+        return (FreeBlock*) uintptr_t(head & PointerMask);
+    }
+
+    static uint64_t pack(FreeBlock *batch, uint64_t head) {
+        return uint64_t(uintptr_t(batch)) | ((head | PointerMask) + 1);
+    }
+
+
+    // units and large allocations are under unitMutex. Units
+    // after currentUnit are left by a rewind, to be carved again
     uint64_t unitSize;
-    uint32_t numUnits;
-    uint32_t unitsUsed;
-    char **units;
-    char *currUnit;
-    char *pos;
+    uint64_t nextUnitSize;
+    QVector<Unit> units;
+    int currentUnit;
+    QHash<char*,Unit> large;
+    uint64_t largeSerial;
+    std::atomic<uint64_t> largeBytes;
+    bool hugePages;
+    mutable QMutex unitMutex;
+    std::atomic<char*> pos;
+    std::atomic<char*> unitEnd;
+
+    bool concurrent;
+    FreeBlock *freeLists[ClassCount];
+    uint64_t requestedBytes;
+    uint64_t usedBytes;
+    uint64_t freeListBytes;
+    uint64_t allocationCounts[ClassCount];
+    int64_t liveCounts[ClassCount];
+    std::atomic<uint64_t> peakBytes;
+
+    // Concurrent mode. The depot of each class is a lock-free
+    // stack of magazines. Its head counts the changes, so that a
+    // magazine taken and given back meanwhile does not fool a
+    // compare-and-swap (the ABA problem)
+    std::atomic<uint64_t> depots[ClassCount];
+    std::atomic<uint64_t> depotBytes;
+    std::atomic<uint64_t> carvedBytes;
+    mutable QMutex cacheMutex;
+    QList<ThreadCache*> threadCaches;
+
+    // statistics of the threads that are gone, under cacheMutex
+    int64_t retiredRequestedBytes;
+    int64_t retiredUsedBytes;
+    uint64_t retiredAllocationCounts[ClassCount];
+    int64_t retiredLiveCounts[ClassCount];
+    QThreadStorage<ThreadCache*> caches;
+
+    // unique among all pools, a thread storage slot left by a
+    // pool that is gone may be handed to a new one
+    uint64_t serial;
 };
 
 } // namespace Ksl
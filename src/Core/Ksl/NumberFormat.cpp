@@ -0,0 +1,369 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Ksl/NumberFormat.h>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+
+namespace Ksl {
+
+// The Grisu2 algorithm of Florian Loitsch, "Printing Floating-Point
+// Numbers Quickly and Accurately with Integers" (PLDI 2010). It only
+// uses 64 bit integer arithmetic and always produces text that reads
+// back as the same double, which is the shortest possible one for
+// all but a very small fraction of inputs
+namespace {
+
+const uint64_t HiddenBit = UINT64_C(0x0010000000000000);
+const uint64_t SignificandMask = UINT64_C(0x000FFFFFFFFFFFFF);
+const uint64_t ExponentMask = UINT64_C(0x7FF0000000000000);
+
+const uint64_t pow10[] = {
+    UINT64_C(1), UINT64_C(10), UINT64_C(100), UINT64_C(1000),
+    UINT64_C(10000), UINT64_C(100000), UINT64_C(1000000),
+    UINT64_C(10000000), UINT64_C(100000000), UINT64_C(1000000000),
+    UINT64_C(10000000000), UINT64_C(100000000000),
+    UINT64_C(1000000000000), UINT64_C(10000000000000),
+    UINT64_C(100000000000000), UINT64_C(1000000000000000),
+    UINT64_C(10000000000000000), UINT64_C(100000000000000000),
+    UINT64_C(1000000000000000000), UINT64_C(10000000000000000000)
+};
+
+
+// A floating point number f * 2^e with a 64 bit significand
+class DiyFp
+{
+public:
+
+    DiyFp() : f(0), e(0) { }
+
+    DiyFp(uint64_t f, int e) : f(f), e(e) { }
+
+    explicit DiyFp(double x) {
+        uint64_t u;
+        std::memcpy(&u, &x, sizeof(u));
+        int biasedExponent = int((u & ExponentMask) >> 52);
+        uint64_t significand = u & SignificandMask;
+        if (biasedExponent != 0) {
+            f = significand + HiddenBit;
+            e = biasedExponent - 1075;
+        } else {
+            f = significand;
+            e = -1074;
+        }
+    }
+
+    DiyFp operator- (const DiyFp &that) const {
+        return DiyFp(f - that.f, e);
+    }
+
+    // upper half of the 128 bit product, rounded
+    DiyFp operator* (const DiyFp &that) const {
+        const uint64_t mask = 0xFFFFFFFF;
+        uint64_t a = f >> 32, b = f & mask;
+        uint64_t c = that.f >> 32, d = that.f & mask;
+        uint64_t ac = a*c, bc = b*c, ad = a*d, bd = b*d;
+        uint64_t mid = (bd >> 32) + (ad & mask) + (bc & mask);
+        mid += uint64_t(1) << 31;
+        return DiyFp(ac + (ad >> 32) + (bc >> 32) + (mid >> 32), e + that.e + 64);
+    }
+
+    DiyFp normalize() const {
+        DiyFp ret = *this;
+#if defined(__GNUC__)
+        int shift = __builtin_clzll(ret.f);
+        ret.f <<= shift;
+        ret.e -= shift;
+#else
+        while ((ret.f & (uint64_t(1) << 63)) == 0) {
+            ret.f <<= 1;
+            ret.e -= 1;
+        }
+#endif
+        return ret;
+    }
+
+    // the numbers half way to the neighbour doubles, scaled
+    // to the exponent of the normalized upper one
+    void boundaries(DiyFp *minus, DiyFp *plus) const {
+        DiyFp upper = DiyFp((f << 1) + 1, e - 1).normalize();
+        DiyFp lower = (f == HiddenBit) ? DiyFp((f << 2) - 1, e - 2)
+                                       : DiyFp((f << 1) - 1, e - 1);
+        lower.f <<= lower.e - upper.e;
+        lower.e = upper.e;
+        *minus = lower;
+        *plus = upper;
+    }
+
+
+    uint64_t f;
+    int e;
+};
+
+
+// Normalized 10^k for k = -348, -340, ..., 340
+DiyFp cachedPower(int e, int *k) {
+    static const uint64_t significands[] = {
+        UINT64_C(0xfa8fd5a0081c0288), UINT64_C(0xbaaee17fa23ebf76), UINT64_C(0x8b16fb203055ac76),
+        UINT64_C(0xcf42894a5dce35ea), UINT64_C(0x9a6bb0aa55653b2d), UINT64_C(0xe61acf033d1a45df),
+        UINT64_C(0xab70fe17c79ac6ca), UINT64_C(0xff77b1fcbebcdc4f), UINT64_C(0xbe5691ef416bd60c),
+        UINT64_C(0x8dd01fad907ffc3c), UINT64_C(0xd3515c2831559a83), UINT64_C(0x9d71ac8fada6c9b5),
+        UINT64_C(0xea9c227723ee8bcb), UINT64_C(0xaecc49914078536d), UINT64_C(0x823c12795db6ce57),
+        UINT64_C(0xc21094364dfb5637), UINT64_C(0x9096ea6f3848984f), UINT64_C(0xd77485cb25823ac7),
+        UINT64_C(0xa086cfcd97bf97f4), UINT64_C(0xef340a98172aace5), UINT64_C(0xb23867fb2a35b28e),
+        UINT64_C(0x84c8d4dfd2c63f3b), UINT64_C(0xc5dd44271ad3cdba), UINT64_C(0x936b9fcebb25c996),
+        UINT64_C(0xdbac6c247d62a584), UINT64_C(0xa3ab66580d5fdaf6), UINT64_C(0xf3e2f893dec3f126),
+        UINT64_C(0xb5b5ada8aaff80b8), UINT64_C(0x87625f056c7c4a8b), UINT64_C(0xc9bcff6034c13053),
+        UINT64_C(0x964e858c91ba2655), UINT64_C(0xdff9772470297ebd), UINT64_C(0xa6dfbd9fb8e5b88f),
+        UINT64_C(0xf8a95fcf88747d94), UINT64_C(0xb94470938fa89bcf), UINT64_C(0x8a08f0f8bf0f156b),
+        UINT64_C(0xcdb02555653131b6), UINT64_C(0x993fe2c6d07b7fac), UINT64_C(0xe45c10c42a2b3b06),
+        UINT64_C(0xaa242499697392d3), UINT64_C(0xfd87b5f28300ca0e), UINT64_C(0xbce5086492111aeb),
+        UINT64_C(0x8cbccc096f5088cc), UINT64_C(0xd1b71758e219652c), UINT64_C(0x9c40000000000000),
+        UINT64_C(0xe8d4a51000000000), UINT64_C(0xad78ebc5ac620000), UINT64_C(0x813f3978f8940984),
+        UINT64_C(0xc097ce7bc90715b3), UINT64_C(0x8f7e32ce7bea5c70), UINT64_C(0xd5d238a4abe98068),
+        UINT64_C(0x9f4f2726179a2245), UINT64_C(0xed63a231d4c4fb27), UINT64_C(0xb0de65388cc8ada8),
+        UINT64_C(0x83c7088e1aab65db), UINT64_C(0xc45d1df942711d9a), UINT64_C(0x924d692ca61be758),
+        UINT64_C(0xda01ee641a708dea), UINT64_C(0xa26da3999aef774a), UINT64_C(0xf209787bb47d6b85),
+        UINT64_C(0xb454e4a179dd1877), UINT64_C(0x865b86925b9bc5c2), UINT64_C(0xc83553c5c8965d3d),
+        UINT64_C(0x952ab45cfa97a0b3), UINT64_C(0xde469fbd99a05fe3), UINT64_C(0xa59bc234db398c25),
+        UINT64_C(0xf6c69a72a3989f5c), UINT64_C(0xb7dcbf5354e9bece), UINT64_C(0x88fcf317f22241e2),
+        UINT64_C(0xcc20ce9bd35c78a5), UINT64_C(0x98165af37b2153df), UINT64_C(0xe2a0b5dc971f303a),
+        UINT64_C(0xa8d9d1535ce3b396), UINT64_C(0xfb9b7cd9a4a7443c), UINT64_C(0xbb764c4ca7a44410),
+        UINT64_C(0x8bab8eefb6409c1a), UINT64_C(0xd01fef10a657842c), UINT64_C(0x9b10a4e5e9913129),
+        UINT64_C(0xe7109bfba19c0c9d), UINT64_C(0xac2820d9623bf429), UINT64_C(0x80444b5e7aa7cf85),
+        UINT64_C(0xbf21e44003acdd2d), UINT64_C(0x8e679c2f5e44ff8f), UINT64_C(0xd433179d9c8cb841),
+        UINT64_C(0x9e19db92b4e31ba9), UINT64_C(0xeb96bf6ebadf77d9), UINT64_C(0xaf87023b9bf0ee6b)
+    };
+    static const int exponents[] = {
+        -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034,
+        -1007, -980, -954, -927, -901, -874, -847, -821,
+        -794, -768, -741, -715, -688, -661, -635, -608,
+        -582, -555, -529, -502, -475, -449, -422, -396,
+        -369, -343, -316, -289, -263, -236, -210, -183,
+        -157, -130, -103, -77, -50, -24, 3, 30,
+        56, 83, 109, 136, 162, 189, 216, 242,
+        269, 295, 322, 348, 375, 402, 428, 455,
+        481, 508, 534, 561, 588, 614, 641, 667,
+        694, 720, 747, 774, 800, 827, 853, 880,
+        907, 933, 960, 986, 1013, 1039, 1066
+    };
+
+    // the smallest power that brings e into [-60,-32]
+    double dk = (-61 - e) * 0.30102999566398114 + 347;
+    int index = int(dk);
+    if (dk - index > 0.0)
+        index += 1;
+    index = (index >> 3) + 1;
+    *k = -(-348 + 8*index);
+    return DiyFp(significands[index], exponents[index]);
+}
+
+
+int decimalDigits(uint32_t n) {
+    int count = 1;
+    while (count < 10 && n >= pow10[count])
+        ++count;
+    return count;
+}
+
+
+// Moves the last digit towards the exact value
+// while it stays inside the rounding interval
+void roundDigit(char *buffer, int length, uint64_t delta,
+                uint64_t rest, uint64_t tenKappa, uint64_t distance)
+{
+    while (rest < distance && delta - rest >= tenKappa &&
+           (rest + tenKappa < distance ||
+            distance - rest > rest + tenKappa - distance))
+    {
+        buffer[length-1] -= 1;
+        rest += tenKappa;
+    }
+}
+
+
+void generateDigits(const DiyFp &w, const DiyFp &upper, uint64_t delta,
+                    char *buffer, int *length, int *k)
+{
+    const DiyFp one(uint64_t(1) << -upper.e, upper.e);
+    const uint64_t distance = (upper - w).f;
+    uint32_t integral = uint32_t(upper.f >> -one.e);
+    uint64_t fraction = upper.f & (one.f - 1);
+    int kappa = decimalDigits(integral);
+    *length = 0;
+
+    while (kappa > 0) {
+        uint32_t divisor = uint32_t(pow10[kappa-1]);
+        uint32_t digit = integral / divisor;
+        integral %= divisor;
+        if (digit != 0 || *length != 0)
+            buffer[(*length)++] = char('0' + digit);
+        kappa -= 1;
+        uint64_t rest = (uint64_t(integral) << -one.e) + fraction;
+        if (rest <= delta) {
+            *k += kappa;
+            roundDigit(buffer, *length, delta, rest,
+                       pow10[kappa] << -one.e, distance);
+            return;
+        }
+    }
+
+    for (;;) {
+        fraction *= 10;
+        delta *= 10;
+        char digit = char(fraction >> -one.e);
+        if (digit != 0 || *length != 0)
+            buffer[(*length)++] = char('0' + digit);
+        fraction &= one.f - 1;
+        kappa -= 1;
+        if (fraction < delta) {
+            *k += kappa;
+            roundDigit(buffer, *length, delta, fraction, one.f,
+                       -kappa < 20 ? distance * pow10[-kappa] : 0);
+            return;
+        }
+    }
+}
+
+
+// Writes the digits of a positive finite x and returns
+// their count, x is then digits * 10^k
+int grisu2(double x, char *buffer, int *k) {
+    const DiyFp v(x);
+    DiyFp minus, plus;
+    v.boundaries(&minus, &plus);
+
+    const DiyFp scale = cachedPower(plus.e, k);
+    const DiyFp w = v.normalize() * scale;
+    DiyFp upper = plus * scale;
+    DiyFp lower = minus * scale;
+    lower.f += 1;
+    upper.f -= 1;
+
+    int length;
+    generateDigits(w, upper, upper.f - lower.f, buffer, &length, k);
+    return length;
+}
+
+
+char* writeExponent(int e, char *out) {
+    *out++ = 'e';
+    if (e < 0) {
+        *out++ = '-';
+        e = -e;
+    }
+    if (e >= 100) {
+        *out++ = char('0' + e/100);
+        e %= 100;
+        *out++ = char('0' + e/10);
+    }
+    else if (e >= 10) {
+        *out++ = char('0' + e/10);
+    }
+    *out++ = char('0' + e%10);
+    return out;
+}
+
+
+// Lays out length digits times 10^k in the buffer
+int layout(char *buffer, int length, int k) {
+    const int point = length + k;
+
+    if (k >= 0 && point <= 21) {
+        // integer, 1234e3 -> 1234000
+        std::memset(buffer + length, '0', k);
+        return point;
+    }
+    if (point > 0 && point <= 21) {
+        // 1234e-2 -> 12.34
+        std::memmove(buffer + point + 1, buffer + point, length - point);
+        buffer[point] = '.';
+        return length + 1;
+    }
+    if (point > -6 && point <= 0) {
+        // 1234e-6 -> 0.001234
+        const int shift = 2 - point;
+        std::memmove(buffer + shift, buffer, length);
+        buffer[0] = '0';
+        buffer[1] = '.';
+        std::memset(buffer + 2, '0', -point);
+        return length + shift;
+    }
+    if (length == 1) {
+        // 1e30
+        return int(writeExponent(point - 1, buffer + 1) - buffer);
+    }
+    // 1234e30 -> 1.234e33
+    std::memmove(buffer + 2, buffer + 1, length - 1);
+    buffer[1] = '.';
+    return int(writeExponent(point - 1, buffer + length + 1) - buffer);
+}
+
+} // namespace
+
+
+int formatDouble(double x, char *buffer) {
+    char *out = buffer;
+    if (std::isnan(x)) {
+        std::memcpy(out, "nan", 4);
+        return 3;
+    }
+    if (std::signbit(x)) {
+        *out++ = '-';
+        x = -x;
+    }
+    if (std::isinf(x)) {
+        std::memcpy(out, "inf", 4);
+        return int(out - buffer) + 3;
+    }
+    if (x == 0.0) {
+        out[0] = '0';
+        out[1] = '\0';
+        return int(out - buffer) + 1;
+    }
+
+    int k;
+    int length = grisu2(x, out, &k);
+    length = layout(out, length, k);
+    out[length] = '\0';
+    return int(out - buffer) + length;
+}
+
+
+int formatInt(qint64 x, char *buffer) {
+    char digits[24];
+    int count = 0;
+    uint64_t u = (x < 0) ? 0 - uint64_t(x) : uint64_t(x);
+    do {
+        digits[count++] = char('0' + u%10);
+        u /= 10;
+    } while (u != 0);
+
+    char *out = buffer;
+    if (x < 0)
+        *out++ = '-';
+    while (count > 0)
+        *out++ = digits[--count];
+    *out = '\0';
+    return int(out - buffer);
+}
+
+} // namespace Ksl
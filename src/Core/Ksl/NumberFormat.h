@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KSL_NUMBERFORMAT_H
+#define KSL_NUMBERFORMAT_H
+
+#include <Ksl/Global.h>
+
+namespace Ksl {
+
+// Space that formatDouble() and formatInt() may
+// need, the terminating '\0' included
+const int FormatBufferSize = 32;
+
+// Writes a decimal text that reads back as exactly x and returns
+// its length. The text is the shortest one for all but a very
+// small fraction of doubles, where it may have one more digit
+// than needed. Numbers from 1e-6 up to 1e21 are
+// written without exponent, like JavaScript does. NaN is written
+// as nan and infinities as inf and -inf
+KSL_EXPORT int formatDouble(double x, char *buffer);
+
+KSL_EXPORT int formatInt(qint64 x, char *buffer);
+
+} // namespace Ksl
+
+#endif // KSL_NUMBERFORMAT_H
@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the public Ksl API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed. Do not include it
+//
+// We mean it.
+//
+
+#ifndef KSL_NUMBERPARSER_P_H
+#define KSL_NUMBERPARSER_P_H
+
+#include <Ksl/Global.h>
+#include <QByteArray>
+#include <cstdint>
+#include <climits>
+
+namespace Ksl {
+
+// Parses a whole decimal integer in [begin,end)
+inline bool parseInt(const char *begin, const char *end, int *value) {
+    const char *p = begin;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        ++p;
+    }
+    if (p == end)
+        return false;
+
+    int64_t x = 0;
+    while (p < end) {
+        unsigned digit = unsigned(*p - '0');
+        if (digit > 9)
+            return false;
+        x = 10*x + digit;
+        if (x > int64_t(INT_MAX) + 1)
+            return false;
+        ++p;
+    }
+    if (negative)
+        x = -x;
+    if (x > INT_MAX)
+        return false;
+    *value = int(x);
+    return true;
+}
+
+
+// Parses a whole floating point number in [begin,end) without
+// looking at the C locale. Numbers with up to 19 significant
+// digits whose value is exactly the product or quotient of two
+// doubles (Clinger's fast path, which covers almost all the data
+// we read) take a few multiplications. The rest goes through Qt's
+// exact, locale independent conversion
+inline bool parseDouble(const char *begin, const char *end, double *value) {
+    static const double powersOfTen[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+        1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+        1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const uint64_t maxExact = uint64_t(1) << 53;
+
+    const char *p = begin;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    bool truncated = false;
+    bool hasDigits = false;
+
+    while (p < end && unsigned(*p - '0') < 10) {
+        if (digits < 19) {
+            mantissa = 10*mantissa + unsigned(*p - '0');
+            if (mantissa != 0) ++digits;
+        } else {
+            exponent += 1;
+            truncated = true;
+        }
+        hasDigits = true;
+        ++p;
+    }
+    if (p < end && *p == '.') {
+        ++p;
+        while (p < end && unsigned(*p - '0') < 10) {
+            if (digits < 19) {
+                mantissa = 10*mantissa + unsigned(*p - '0');
+                exponent -= 1;
+                if (mantissa != 0) ++digits;
+            } else {
+                truncated = true;
+            }
+            hasDigits = true;
+            ++p;
+        }
+    }
+
+    if (!hasDigits) {
+        // only nan and inf are worth a second look
+        if (p == end || (*p != 'n' && *p != 'N' && *p != 'i' && *p != 'I'))
+            return false;
+        truncated = true;
+    }
+    else if (p < end && (*p == 'e' || *p == 'E')) {
+        ++p;
+        bool negativeExp = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negativeExp = (*p == '-');
+            ++p;
+        }
+        if (p == end || unsigned(*p - '0') > 9)
+            return false;
+        int e = 0;
+        while (p < end && unsigned(*p - '0') < 10) {
+            if (e < 100000)
+                e = 10*e + int(*p - '0');
+            ++p;
+        }
+        exponent += negativeExp ? -e : e;
+    }
+
+    if (!truncated) {
+        if (p != end)
+            return false;
+        if (mantissa == 0) {
+            *value = negative ? -0.0 : 0.0;
+            return true;
+        }
+        if (mantissa <= maxExact) {
+            // fold surplus positive powers into the mantissa
+            // while it stays exactly representable
+            while (exponent > 22 && mantissa <= maxExact/10) {
+                mantissa *= 10;
+                exponent -= 1;
+            }
+            if (exponent >= -22 && exponent <= 22) {
+                double x = double(mantissa);
+                x = (exponent < 0) ? x / powersOfTen[-exponent]
+                                   : x * powersOfTen[exponent];
+                *value = negative ? -x : x;
+                return true;
+            }
+        }
+    }
+
+    bool ok;
+    double x = QByteArray::fromRawData(begin, int(end - begin)).toDouble(&ok);
+    if (ok)
+        *value = x;
+    return ok;
+}
+
+} // namespace Ksl
+
+#endif // KSL_NUMBERPARSER_P_H
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KSL_POOLALLOCATOR_H
+#define KSL_POOLALLOCATOR_H
+
+#include <Ksl/MemoryPool.h>
+#include <cstddef>
+#include <new>
+
+#if __cplusplus >= 201703L
+#include <memory_resource>
+#endif
+
+namespace Ksl {
+
+// A standard allocator drawing from a MemoryPool, so that
+// containers like std::vector and std::unordered_map keep their
+// nodes in a pool. Copies share the pool, which must outlive
+// them
+template <typename T>
+class PoolAllocator
+{
+public:
+
+    typedef T value_type;
+
+    PoolAllocator(MemoryPool *pool)
+        : m_pool(pool)
+    { }
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &that)
+        : m_pool(that.pool())
+    { }
+
+    T* allocate(size_t n) {
+        void *ptr = m_pool->allocBytes(n*sizeof(T), alignof(T));
+        if (ptr == nullptr)
+            throw std::bad_alloc();
+        return (T*) ptr;
+    }
+
+    void deallocate(T *ptr, size_t n) {
+        m_pool->freeBytes(ptr, n*sizeof(T), alignof(T));
+    }
+
+    MemoryPool* pool() const { return m_pool; }
+
+private:
+
+    MemoryPool *m_pool;
+};
+
+
+template <typename T, typename U>
+inline bool operator==(const PoolAllocator<T> &a, const PoolAllocator<U> &b) {
+    return a.pool() == b.pool();
+}
+
+template <typename T, typename U>
+inline bool operator!=(const PoolAllocator<T> &a, const PoolAllocator<U> &b) {
+    return a.pool() != b.pool();
+}
+
+
+#if __cplusplus >= 201703L
+
+// The same for the polymorphic containers of std::pmr, where
+// the allocator type does not depend on the resource
+class PoolResource
+    : public std::pmr::memory_resource
+{
+public:
+
+    PoolResource(MemoryPool *pool)
+        : m_pool(pool)
+    { }
+
+    MemoryPool* pool() const { return m_pool; }
+
+protected:
+
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        void *ptr = m_pool->allocBytes(bytes, alignment);
+        if (ptr == nullptr)
+            throw std::bad_alloc();
+        return ptr;
+    }
+
+    void do_deallocate(void *ptr, size_t bytes, size_t alignment) override {
+        m_pool->freeBytes(ptr, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &that) const noexcept override {
+        auto other = dynamic_cast<const PoolResource*>(&that);
+        return other != nullptr && other->m_pool == m_pool;
+    }
+
+private:
+
+    MemoryPool *m_pool;
+};
+
+#endif // __cplusplus >= 201703L
+
+} // namespace Ksl
+
+#endif // KSL_POOLALLOCATOR_H
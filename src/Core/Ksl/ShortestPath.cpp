@@ -0,0 +1,454 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Ksl/ShortestPath_p.h>
+#include <QDebug>
+#include <QList>
+#include <QThread>
+#include <QtConcurrentRun>
+#include <algorithm>
+#include <limits>
+
+namespace Ksl {
+
+ShortestPath::ShortestPath()
+    : Ksl::Object(new ShortestPathPrivate(this))
+{ }
+
+
+bool ShortestPath::setGraph(uint32_t vertexCount, const uint64_t *offsets,
+                            const uint32_t *targets, const double *weights)
+{
+    KSL_PUBLIC(ShortestPath);
+    m->count = 0;
+    m->ownWeights = Array<1>();
+    m->inOffsets.clear();
+    m->inSources.clear();
+    m->inWeights.clear();
+    m->distances = Array<1>();
+    m->parents = Array<1,int>();
+
+    const uint64_t edgeCount = offsets[vertexCount];
+    double sum = 0.0, max = 0.0;
+    for (uint64_t e=0; e<edgeCount; ++e) {
+        // also rejects NaN
+        if (!(weights[e] >= 0.0)) {
+            qDebug() << "ShortestPath::setGraph: Negative edge weight!";
+            return false;
+        }
+        sum += weights[e];
+        max = qMax(max, weights[e]);
+    }
+
+    m->count = vertexCount;
+    m->offsets = offsets;
+    m->targets = targets;
+    m->weights = weights;
+    m->meanWeight = edgeCount ? sum / double(edgeCount) : 0.0;
+    m->maxWeight = max;
+    return true;
+}
+
+
+bool ShortestPath::setGraph(uint32_t vertexCount, const uint64_t *offsets,
+                            const uint32_t *targets, const Array<1> &weights)
+{
+    KSL_PUBLIC(ShortestPath);
+    if (!setGraph(vertexCount, offsets, targets, weights.begin()))
+        return false;
+    // keeps the weights alive
+    m->ownWeights = weights;
+    return true;
+}
+
+
+void ShortestPath::setMethod(Method method) {
+    KSL_PUBLIC(ShortestPath);
+    m->method = method;
+}
+
+
+ShortestPath::Method ShortestPath::method() const {
+    KSL_PUBLIC(const ShortestPath);
+    return m->method;
+}
+
+
+void ShortestPath::setArity(int arity) {
+    KSL_PUBLIC(ShortestPath);
+    m->arity = qMax(arity, 2);
+}
+
+
+int ShortestPath::arity() const {
+    KSL_PUBLIC(const ShortestPath);
+    return m->arity;
+}
+
+
+void ShortestPath::setDelta(double delta) {
+    KSL_PUBLIC(ShortestPath);
+    m->delta = qMax(delta, 0.0);
+}
+
+
+double ShortestPath::delta() const {
+    KSL_PUBLIC(const ShortestPath);
+    return m->delta;
+}
+
+
+void ShortestPath::setParallel(bool parallel) {
+    KSL_PUBLIC(ShortestPath);
+    m->parallel = parallel;
+}
+
+
+bool ShortestPath::parallel() const {
+    KSL_PUBLIC(const ShortestPath);
+    return m->parallel;
+}
+
+
+bool ShortestPath::run(uint32_t source) {
+    KSL_PUBLIC(ShortestPath);
+    if (source >= m->count || m->count > uint32_t(std::numeric_limits<int>::max()))
+        return false;
+
+    m->source = source;
+    m->distances = Array<1>(int(m->count), std::numeric_limits<double>::infinity());
+    m->parents = Array<1,int>(int(m->count), -1);
+    double *dist = m->distances.begin();
+    int *parent = m->parents.begin();
+    dist[source] = 0.0;
+
+    switch (m->method) {
+    case Dijkstra:
+        m->runDijkstra(source, dist, parent);
+        break;
+    case RadixDijkstra:
+        m->runRadix(source, dist, parent);
+        break;
+    case DeltaStepping:
+        m->runDeltaStepping(source, dist, parent);
+        break;
+    }
+    return true;
+}
+
+
+Array<1> ShortestPath::distances() const {
+    KSL_PUBLIC(const ShortestPath);
+    return m->distances;
+}
+
+
+Array<1,int> ShortestPath::parents() const {
+    KSL_PUBLIC(const ShortestPath);
+    return m->parents;
+}
+
+
+Array<1,int> ShortestPath::path(uint32_t target) const {
+    KSL_PUBLIC(const ShortestPath);
+    if (target >= uint32_t(m->parents.size()))
+        return Array<1,int>();
+    if (target != m->source && m->parents[int(target)] < 0)
+        return Array<1,int>();
+
+    QVector<int> reversed;
+    for (int vertex=int(target); vertex>=0; vertex=m->parents[vertex])
+        reversed.append(vertex);
+    Array<1,int> ret(reversed.size());
+    for (int k=0; k<reversed.size(); ++k)
+        ret[k] = reversed[reversed.size() - 1 - k];
+    return std::move(ret);
+}
+
+
+double ShortestPath::distance(uint32_t source, uint32_t target, Array<1,int> *path) {
+    KSL_PUBLIC(ShortestPath);
+    const double inf = std::numeric_limits<double>::infinity();
+    if (path != nullptr)
+        *path = Array<1,int>();
+    if (source >= m->count || target >= m->count)
+        return inf;
+    if (m->inOffsets.empty())
+        m->transpose();
+
+    // Forward search from the source over the graph, backward
+    // search from the target over the reversed graph, each
+    // settling the closest vertex of the smaller heap
+    const uint32_t count = m->count;
+    std::vector<double> dist[2] = { std::vector<double>(count, inf),
+                                    std::vector<double>(count, inf) };
+    std::vector<int> parent[2] = { std::vector<int>(count, -1),
+                                   std::vector<int>(count, -1) };
+    std::vector<bool> settled[2] = { std::vector<bool>(count, false),
+                                     std::vector<bool>(count, false) };
+    const uint64_t *offsets[2] = { m->offsets, m->inOffsets.data() };
+    const uint32_t *targets[2] = { m->targets, m->inSources.data() };
+    const double *weights[2] = { m->weights, m->inWeights.data() };
+
+    ShortestPathPrivate::DaryHeap heap0(count, m->arity, dist[0].data());
+    ShortestPathPrivate::DaryHeap heap1(count, m->arity, dist[1].data());
+    ShortestPathPrivate::DaryHeap *heaps[2] = { &heap0, &heap1 };
+    dist[0][source] = 0.0;
+    dist[1][target] = 0.0;
+    heap0.update(source);
+    heap1.update(target);
+
+    // best path found so far, through the edge meetFrom-meetTo
+    double best = inf;
+    uint32_t meetFrom = source, meetTo = source;
+    if (source == target)
+        best = 0.0;
+
+    while (!heap0.empty() && !heap1.empty()) {
+        // no path through unsettled vertices can be shorter
+        if (heap0.topKey() + heap1.topKey() >= best)
+            break;
+        const int side = heap0.topKey() <= heap1.topKey() ? 0 : 1;
+        const uint32_t vertex = heaps[side]->pop();
+        settled[side][vertex] = true;
+
+        const double d = dist[side][vertex];
+        const uint64_t last = offsets[side][vertex+1];
+        for (uint64_t e=offsets[side][vertex]; e<last; ++e) {
+            const uint32_t next = targets[side][e];
+            const double nd = d + weights[side][e];
+            if (nd < dist[side][next] && !settled[side][next]) {
+                dist[side][next] = nd;
+                parent[side][next] = int(vertex);
+                heaps[side]->update(next);
+            }
+            // a path from the source to the target through the edge
+            if (dist[1-side][next] < inf && nd + dist[1-side][next] < best) {
+                best = nd + dist[1-side][next];
+                meetFrom = side == 0 ? vertex : next;
+                meetTo = side == 0 ? next : vertex;
+            }
+        }
+    }
+
+    if (path != nullptr && best < inf) {
+        QVector<int> vertices;
+        if (source != target) {
+            for (int v=int(meetFrom); v>=0; v=parent[0][v])
+                vertices.prepend(v);
+            for (int v=int(meetTo); v>=0; v=parent[1][v])
+                vertices.append(v);
+        }
+        else {
+            vertices.append(int(source));
+        }
+        Array<1,int> ret(vertices.size());
+        for (int k=0; k<vertices.size(); ++k)
+            ret[k] = vertices[k];
+        *path = ret;
+    }
+    return best;
+}
+
+
+void ShortestPathPrivate::runDijkstra(uint32_t source, double *dist, int *parent) const {
+    DaryHeap heap(count, arity, dist);
+    heap.update(source);
+    std::vector<bool> settled(count, false);
+    while (!heap.empty()) {
+        const uint32_t vertex = heap.pop();
+        settled[vertex] = true;
+        const double d = dist[vertex];
+        const uint64_t last = offsets[vertex+1];
+        for (uint64_t e=offsets[vertex]; e<last; ++e) {
+            const uint32_t next = targets[e];
+            const double nd = d + weights[e];
+            if (nd < dist[next] && !settled[next]) {
+                dist[next] = nd;
+                parent[next] = int(vertex);
+                heap.update(next);
+            }
+        }
+    }
+}
+
+
+void ShortestPathPrivate::runRadix(uint32_t source, double *dist, int *parent) const {
+    RadixHeap heap;
+    heap.push(0.0, source);
+    while (!heap.empty()) {
+        auto top = heap.pop();
+        const uint32_t vertex = top.second;
+        // skip the entries left by decreased keys
+        if (top.first != RadixHeap::bits(dist[vertex]))
+            continue;
+        const double d = dist[vertex];
+        const uint64_t last = offsets[vertex+1];
+        for (uint64_t e=offsets[vertex]; e<last; ++e) {
+            const uint32_t next = targets[e];
+            const double nd = d + weights[e];
+            if (nd < dist[next]) {
+                dist[next] = nd;
+                parent[next] = int(vertex);
+                heap.push(nd, next);
+            }
+        }
+    }
+}
+
+
+void ShortestPathPrivate::runDeltaStepping(uint32_t source, double *dist, int *parent) const {
+    double width = delta > 0.0 ? delta : meanWeight;
+    if (!(width > 0.0))
+        width = 1.0;
+
+    // Tentative distances are never more than maxWeight past the
+    // bucket being settled, so a ring of buckets is enough. When
+    // the ring is capped, vertices of a later lap wait their turn
+    const uint64_t ringSize = uint64_t(std::min(maxWeight / width, 1e6)) + 2;
+    std::vector< std::vector<uint32_t> > ring(ringSize);
+    auto bucketOf = [&](double d) { return uint64_t(d / width); };
+    ring[0].push_back(source);
+    uint64_t pending = 1;
+
+    const int maxThreads = parallel ? qMax(QThread::idealThreadCount(), 1) : 1;
+    std::vector<uint32_t> stamp(count, 0);
+    uint32_t round = 0;
+
+    // Relaxes the light or heavy edges of vertices, in parallel
+    // when there are enough, and applies the requests in order
+    auto relaxAll = [&](const std::vector<uint32_t> &vertices, bool light) {
+        Phase phase;
+        phase.graph = this;
+        phase.distances = dist;
+        phase.light = light;
+
+        const int threads = int(qMin(uint32_t(maxThreads),
+            qMax(uint32_t(vertices.size()) / MinThreadVertices, uint32_t(1))));
+        QList< std::vector<Request> > parts;
+        const uint32_t *first = vertices.data();
+        if (threads == 1) {
+            parts.append(relax(&phase, first, first + vertices.size()));
+        }
+        else {
+            QList< QFuture< std::vector<Request> > > futures;
+            for (int k=0; k<threads; ++k) {
+                size_t begin = vertices.size() * k / threads;
+                size_t end = vertices.size() * (k+1) / threads;
+                futures.append(QtConcurrent::run(&ShortestPathPrivate::relax, &phase,
+                                                 first + begin, first + end));
+            }
+            for (auto &future : futures)
+                parts.append(future.result());
+        }
+        for (const auto &part : parts) {
+            for (const Request &request : part) {
+                if (request.distance < dist[request.vertex]) {
+                    dist[request.vertex] = request.distance;
+                    parent[request.vertex] = int(request.parent);
+                    ring[bucketOf(request.distance) % ringSize].push_back(request.vertex);
+                    ++pending;
+                }
+            }
+        }
+    };
+
+    for (uint64_t bucket=0; pending>0; ++bucket) {
+        std::vector<uint32_t> &current = ring[bucket % ringSize];
+        std::vector<uint32_t> settled, later;
+
+        // light edges may put vertices back in the bucket
+        while (!current.empty()) {
+            std::vector<uint32_t> batch;
+            batch.swap(current);
+            pending -= batch.size();
+            ++round;
+            std::vector<uint32_t> live;
+            for (uint32_t vertex : batch) {
+                // skip repeats and vertices moved to a lower bucket
+                const uint64_t at = bucketOf(dist[vertex]);
+                if (at > bucket)
+                    later.push_back(vertex);
+                if (at != bucket || stamp[vertex] == round)
+                    continue;
+                stamp[vertex] = round;
+                live.push_back(vertex);
+            }
+            relaxAll(live, true);
+            settled.insert(settled.end(), live.begin(), live.end());
+        }
+        current.swap(later);
+        pending += current.size();
+
+        std::sort(settled.begin(), settled.end());
+        settled.erase(std::unique(settled.begin(), settled.end()), settled.end());
+        relaxAll(settled, false);
+    }
+}
+
+
+std::vector<ShortestPathPrivate::Request> ShortestPathPrivate::relax(
+    const Phase *phase, const uint32_t *begin, const uint32_t *end)
+{
+    std::vector<Request> ret;
+    const ShortestPathPrivate *graph = phase->graph;
+    const double *dist = phase->distances;
+    double width = graph->delta > 0.0 ? graph->delta : graph->meanWeight;
+    if (!(width > 0.0))
+        width = 1.0;
+
+    for (const uint32_t *vertex=begin; vertex<end; ++vertex) {
+        const double d = dist[*vertex];
+        const uint64_t last = graph->offsets[*vertex+1];
+        for (uint64_t e=graph->offsets[*vertex]; e<last; ++e) {
+            const double weight = graph->weights[e];
+            if ((weight <= width) != phase->light)
+                continue;
+            const uint32_t next = graph->targets[e];
+            if (d + weight < dist[next])
+                ret.push_back({ next, *vertex, d + weight });
+        }
+    }
+    return std::move(ret);
+}
+
+
+void ShortestPathPrivate::transpose() {
+    // counting sort of the edges by target
+    inOffsets.assign(count + 1, 0);
+    const uint64_t edgeCount = offsets[count];
+    for (uint64_t e=0; e<edgeCount; ++e)
+        inOffsets[targets[e] + 1] += 1;
+    for (uint32_t v=0; v<count; ++v)
+        inOffsets[v+1] += inOffsets[v];
+
+    inSources.resize(edgeCount);
+    inWeights.resize(edgeCount);
+    std::vector<uint64_t> pos(inOffsets.begin(), inOffsets.end() - 1);
+    for (uint32_t v=0; v<count; ++v) {
+        for (uint64_t e=offsets[v]; e<offsets[v+1]; ++e) {
+            const uint64_t at = pos[targets[e]]++;
+            inSources[at] = v;
+            inWeights[at] = weights[e];
+        }
+    }
+}
+
+} // namespace Ksl
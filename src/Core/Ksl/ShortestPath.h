@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KSL_SHORTESTPATH_H
+#define KSL_SHORTESTPATH_H
+
+#include <Ksl/Array.h>
+#include <Ksl/Graph.h>
+#include <Ksl/Object.h>
+
+namespace Ksl {
+
+// Single-source and point-to-point shortest paths over a graph in
+// compressed sparse row layout, with non-negative edge weights.
+// The graph arrays are not copied and must outlive their use
+class KSL_EXPORT ShortestPath
+    : public Ksl::Object
+{
+public:
+
+    enum Method {
+        // Dijkstra's algorithm with a d-ary heap
+        Dijkstra,
+        // Dijkstra's algorithm with a radix heap, which takes
+        // constant time per push whatever the heap size
+        RadixDijkstra,
+        // Vertices are settled by buckets of distance, with the
+        // edges of a bucket relaxed on all cores when parallel
+        DeltaStepping
+    };
+
+
+    ShortestPath();
+
+
+    // The weights of the edges of a FrozenGraph are its edge
+    // data, copied unless they already are doubles
+    template <typename VertData>
+    bool setGraph(const FrozenGraph<VertData,double> &graph) {
+        return setGraph(graph.vertexCount(), graph.offsets(),
+                        graph.targets(), graph.edgeData());
+    }
+
+    template <typename VertData, typename EdgeData>
+    bool setGraph(const FrozenGraph<VertData,EdgeData> &graph) {
+        Array<1> weights(int(graph.edgeCount()));
+        const EdgeData *data = graph.edgeData();
+        for (int k=0; k<weights.size(); ++k)
+            weights[k] = double(data[k]);
+        return setGraph(graph.vertexCount(), graph.offsets(),
+                        graph.targets(), weights);
+    }
+
+    // The edges of vertex v go to targets[offsets[v]] up to
+    // targets[offsets[v+1]], with the same positions of weights.
+    // Fails if a weight is negative
+    bool setGraph(uint32_t vertexCount, const uint64_t *offsets,
+                  const uint32_t *targets, const double *weights);
+
+    bool setGraph(uint32_t vertexCount, const uint64_t *offsets,
+                  const uint32_t *targets, const Array<1> &weights);
+
+
+    void setMethod(Method method);
+
+    Method method() const;
+
+    // Children per node of the heap of Dijkstra
+    void setArity(int arity);
+
+    int arity() const;
+
+    // Width of the buckets of DeltaStepping, 0 takes the
+    // mean edge weight
+    void setDelta(double delta);
+
+    double delta() const;
+
+    void setParallel(bool parallel);
+
+    bool parallel() const;
+
+
+    // Distances from source to every vertex
+    bool run(uint32_t source);
+
+    // Infinite if the vertex was not reached
+    Array<1> distances() const;
+
+    // The vertex before each one in its shortest path, -1 for
+    // the source and the vertices not reached
+    Array<1,int> parents() const;
+
+    // The vertices from the source of the last run() to target
+    Array<1,int> path(uint32_t target) const;
+
+
+    // Distance from source to target, searching from both ends
+    // at once until the searches meet. Infinite if there is no
+    // path, which is put in path when given
+    double distance(uint32_t source, uint32_t target, Array<1,int> *path=nullptr);
+};
+
+} // namespace Ksl
+
+#endif // KSL_SHORTESTPATH_H
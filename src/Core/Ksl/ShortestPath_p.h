@@ -0,0 +1,271 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the public Ksl API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed. Do not include it
+//
+// We mean it.
+//
+
+#ifndef KSL_SHORTESTPATH_P_H
+#define KSL_SHORTESTPATH_P_H
+
+#include <Ksl/ShortestPath.h>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace Ksl {
+
+class ShortestPathPrivate
+    : public Ksl::ObjectPrivate
+{
+public:
+
+    ShortestPathPrivate(ShortestPath *publ)
+        : Ksl::ObjectPrivate(publ)
+        , count(0)
+        , offsets(nullptr)
+        , targets(nullptr)
+        , weights(nullptr)
+        , meanWeight(0.0)
+        , maxWeight(0.0)
+        , method(ShortestPath::Dijkstra)
+        , arity(4)
+        , delta(0.0)
+        , parallel(false)
+        , source(0)
+    { }
+
+    // Buckets with fewer vertices than that are not split
+    static const uint32_t MinThreadVertices = 4096;
+
+
+    // A heap of vertices keyed by their distances, with d
+    // children per node. The position of each vertex is kept
+    // so that its key can be decreased
+    class DaryHeap
+    {
+    public:
+
+        DaryHeap(uint32_t count, int arity, const double *keys)
+            : arity(arity)
+            , keys(keys)
+            , position(count, -1)
+        { }
+
+        bool empty() const { return heap.empty(); }
+
+        // Inserts vertex or moves it up after its key decreased
+        void update(uint32_t vertex) {
+            int pos = position[vertex];
+            if (pos < 0) {
+                pos = int(heap.size());
+                heap.push_back(vertex);
+            }
+            up(pos);
+        }
+
+        uint32_t pop() {
+            uint32_t top = heap.front();
+            position[top] = -1;
+            uint32_t last = heap.back();
+            heap.pop_back();
+            if (!heap.empty()) {
+                heap[0] = last;
+                position[last] = 0;
+                down(0);
+            }
+            return top;
+        }
+
+        double topKey() const { return keys[heap.front()]; }
+
+    private:
+
+        void up(int pos) {
+            uint32_t vertex = heap[pos];
+            while (pos > 0) {
+                int parent = (pos - 1) / arity;
+                if (keys[heap[parent]] <= keys[vertex])
+                    break;
+                heap[pos] = heap[parent];
+                position[heap[pos]] = pos;
+                pos = parent;
+            }
+            heap[pos] = vertex;
+            position[vertex] = pos;
+        }
+
+        void down(int pos) {
+            uint32_t vertex = heap[pos];
+            const int size = int(heap.size());
+            for (;;) {
+                int first = pos*arity + 1;
+                if (first >= size)
+                    break;
+                int best = first;
+                int last = qMin(first + arity, size);
+                for (int child=first+1; child<last; ++child) {
+                    if (keys[heap[child]] < keys[heap[best]])
+                        best = child;
+                }
+                if (keys[heap[best]] >= keys[vertex])
+                    break;
+                heap[pos] = heap[best];
+                position[heap[pos]] = pos;
+                pos = best;
+            }
+            heap[pos] = vertex;
+            position[vertex] = pos;
+        }
+
+        int arity;
+        const double *keys;
+        std::vector<int> position;
+        std::vector<uint32_t> heap;
+    };
+
+
+    // A monotone heap: keys never go below the last one popped,
+    // as in Dijkstra's algorithm. Non-negative doubles order like
+    // their bits, which are put in the bucket of the highest bit
+    // where they differ from the last key. A vertex is pushed
+    // again when its key decreases, the stale entries are
+    // skipped by the caller
+    class RadixHeap
+    {
+    public:
+
+        RadixHeap()
+            : last(0)
+            , size(0)
+        { }
+
+        bool empty() const { return size == 0; }
+
+        static uint64_t bits(double key) {
+            uint64_t ret;
+            std::memcpy(&ret, &key, sizeof(ret));
+            return ret;
+        }
+
+        void push(double key, uint32_t vertex) {
+            uint64_t k = bits(key);
+            buckets[bucketOf(k)].push_back(std::make_pair(k, vertex));
+            ++size;
+        }
+
+        // Returns the vertex with the lowest key, and its key
+        std::pair<uint64_t,uint32_t> pop() {
+            if (buckets[0].empty()) {
+                int b = 1;
+                while (buckets[b].empty())
+                    ++b;
+                // the lowest key of the bucket becomes the last, the
+                // others fall to lower buckets
+                uint64_t lowest = buckets[b].front().first;
+                for (const auto &entry : buckets[b])
+                    lowest = qMin(lowest, entry.first);
+                last = lowest;
+                for (const auto &entry : buckets[b])
+                    buckets[bucketOf(entry.first)].push_back(entry);
+                buckets[b].clear();
+            }
+            auto ret = buckets[0].back();
+            buckets[0].pop_back();
+            --size;
+            return ret;
+        }
+
+    private:
+
+        int bucketOf(uint64_t key) const {
+            return key == last ? 0 : 64 - __builtin_clzll(key ^ last);
+        }
+
+        uint64_t last;
+        uint64_t size;
+        std::vector< std::pair<uint64_t,uint32_t> > buckets[65];
+    };
+
+
+    // A better distance for a vertex, found by a relaxation
+    class Request
+    {
+    public:
+
+        uint32_t vertex;
+        uint32_t parent;
+        double distance;
+    };
+
+
+    // What the threads of a DeltaStepping phase read
+    class Phase
+    {
+    public:
+
+        const ShortestPathPrivate *graph;
+        const double *distances;
+        bool light;
+    };
+
+
+    void runDijkstra(uint32_t source, double *dist, int *parent) const;
+    void runRadix(uint32_t source, double *dist, int *parent) const;
+    void runDeltaStepping(uint32_t source, double *dist, int *parent) const;
+    static std::vector<Request> relax(const Phase *phase, const uint32_t *begin,
+                                      const uint32_t *end);
+    void transpose();
+
+
+    uint32_t count;
+    const uint64_t *offsets;
+    const uint32_t *targets;
+    const double *weights;
+    Array<1> ownWeights;
+    double meanWeight;
+    double maxWeight;
+
+    // the reversed graph, for the backward search of distance()
+    std::vector<uint64_t> inOffsets;
+    std::vector<uint32_t> inSources;
+    std::vector<double> inWeights;
+
+    ShortestPath::Method method;
+    int arity;
+    double delta;
+    bool parallel;
+
+    uint32_t source;
+    Array<1> distances;
+    Array<1,int> parents;
+};
+
+} // namespace Ksl
+
+#endif // KSL_SHORTESTPATH_P_H
@@ -0,0 +1,269 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Ksl/Table.h>
+#include <Ksl/NumberFormat.h>
+#include <QDebug>
+#include <limits>
+
+namespace Ksl {
+
+TableColumn::TableColumn()
+    : m_type(Real)
+    , m_offset(0)
+    , m_size(0)
+{ }
+
+
+TableColumn::TableColumn(const Array<1> &reals)
+    : m_type(Real)
+    , m_offset(0)
+    , m_size(reals.size())
+    , m_reals(reals)
+{
+    findNulls();
+}
+
+
+TableColumn::TableColumn(const Array<1,int> &ints)
+    : m_type(Integer)
+    , m_offset(0)
+    , m_size(ints.size())
+    , m_ints(ints)
+{ }
+
+
+TableColumn::TableColumn(const Array<1,int> &codes,
+                         const QVector<QString> &categories)
+    : m_type(Text)
+    , m_offset(0)
+    , m_size(codes.size())
+    , m_ints(codes)
+    , m_strings(categories)
+{
+    findNulls();
+}
+
+
+TableColumn::TableColumn(const QVector<QString> &texts)
+    : m_type(Text)
+    , m_offset(0)
+    , m_size(texts.size())
+    , m_strings(texts)
+{
+    findNulls();
+}
+
+
+void TableColumn::findNulls() {
+    const int words = (m_size + 63) / 64;
+    Array<1,quint64> bits;
+    for (int k=0; k<m_size; ++k) {
+        bool null;
+        if (m_type == Real)
+            null = (m_reals[k] != m_reals[k]);
+        else if (m_ints.size() > 0)
+            null = (m_ints[k] < 0);
+        else
+            null = m_strings[k].isNull();
+        if (!null)
+            continue;
+        if (!bits.size())
+            bits = Array<1,quint64>(words, 0);
+        bits[k >> 6] |= quint64(1) << (k & 63);
+    }
+    m_nulls = bits;
+}
+
+
+int TableColumn::nullCount() const {
+    if (!m_nulls.size())
+        return 0;
+    int count = 0;
+    for (int k=0; k<m_size; ++k)
+        count += isNull(k) ? 1 : 0;
+    return count;
+}
+
+
+double TableColumn::real(int row) const {
+    if (m_type == Real)
+        return m_reals[m_offset + row];
+    if (m_type == Integer)
+        return double(m_ints[m_offset + row]);
+    if (!isNull(row)) {
+        bool ok;
+        double x = text(row).toDouble(&ok);
+        if (ok)
+            return x;
+    }
+    return std::numeric_limits<double>::quiet_NaN();
+}
+
+
+QString TableColumn::text(int row) const {
+    if (isNull(row))
+        return QString();
+    if (m_type == Real) {
+        char buffer[FormatBufferSize];
+        formatDouble(m_reals[m_offset + row], buffer);
+        return QString::fromLatin1(buffer);
+    }
+    if (m_type == Integer)
+        return QString::number(m_ints[m_offset + row]);
+    if (m_ints.size() > 0)
+        return m_strings[m_ints[m_offset + row]];
+    return m_strings[m_offset + row];
+}
+
+
+const double* TableColumn::reals() const {
+    if (m_type != Real || m_size == 0)
+        return nullptr;
+    return m_reals.begin() + m_offset;
+}
+
+
+const int* TableColumn::ints() const {
+    if (m_type == Real || m_size == 0 || m_ints.size() == 0)
+        return nullptr;
+    return m_ints.begin() + m_offset;
+}
+
+
+TableColumn TableColumn::slice(int begin, int size) const {
+    TableColumn ret(*this);
+    begin = qBound(0, begin, m_size);
+    ret.m_offset = m_offset + begin;
+    ret.m_size = qBound(0, size, m_size - begin);
+    return std::move(ret);
+}
+
+
+Array<1> TableColumn::array() const {
+    if (m_type == Real && m_offset == 0 && m_size == m_reals.size())
+        return m_reals;
+    Array<1> ret(m_size);
+    for (int k=0; k<m_size; ++k)
+        ret[k] = real(k);
+    return std::move(ret);
+}
+
+
+Table::Table()
+    : m_rows(0)
+{ }
+
+
+bool Table::append(const QString &key, const TableColumn &column) {
+    if (!m_columns.isEmpty() && column.size() != m_rows) {
+        qDebug() << "Table::append: Column" << key << "has"
+                 << column.size() << "rows, not" << m_rows;
+        return false;
+    }
+    m_keys.append(key);
+    m_columns.append(column);
+    m_rows = column.size();
+    return true;
+}
+
+
+const TableColumn& Table::column(const QString &key) const {
+    static const TableColumn none;
+    int index = indexOf(key);
+    if (index < 0)
+        return none;
+    return m_columns[index];
+}
+
+
+TableColumn::Type Table::columnType(const QString &key) const {
+    return column(key).type();
+}
+
+
+Table Table::select(const QStringList &keys) const {
+    Table ret;
+    for (auto &key : keys) {
+        int index = indexOf(key);
+        if (index < 0)
+            qDebug() << "Table::select: No column" << key;
+        else
+            ret.append(key, m_columns[index]);
+    }
+    return std::move(ret);
+}
+
+
+Table Table::select(const Array<1,int> &indexes) const {
+    Table ret;
+    for (auto index : indexes) {
+        if (index >= 0 && index < m_columns.size())
+            ret.append(m_keys[index], m_columns[index]);
+    }
+    return std::move(ret);
+}
+
+
+Table Table::slice(int begin, int rows) const {
+    Table ret;
+    for (int k=0; k<m_columns.size(); ++k)
+        ret.append(m_keys[k], m_columns[k].slice(begin, rows));
+    return std::move(ret);
+}
+
+
+Array<1> Table::array(const QString &key) const {
+    int index = indexOf(key);
+    if (index < 0)
+        return Array<1>();
+    return array(index);
+}
+
+
+Array<2> Table::matrix() const {
+    Array<2> ret(m_rows, m_columns.size());
+    for (int j=0; j<m_columns.size(); ++j)
+        fillcol(ret, j, j);
+    return std::move(ret);
+}
+
+
+void Table::fillcol(Array<2> &a, int j, const QString &key) const {
+    int index = indexOf(key);
+    if (index >= 0)
+        fillcol(a, j, index);
+}
+
+
+void Table::fillcol(Array<2> &a, int j, int col) const {
+    const TableColumn &column = m_columns[col];
+    const int rows = qMin(m_rows, a.rows());
+    if (column.reals()) {
+        const double *values = column.reals();
+        for (int i=0; i<rows; ++i)
+            a[i][j] = values[i];
+    } else {
+        for (int i=0; i<rows; ++i)
+            a[i][j] = column.real(i);
+    }
+}
+
+} // namespace Ksl
@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KSL_TABLE_H
+#define KSL_TABLE_H
+
+#include <Ksl/Array.h>
+#include <QStringList>
+#include <QVector>
+
+namespace Ksl {
+
+/****************************************************
+ * One column of a Table. The values live in Array
+ * storage shared with the arrays they came from and
+ * with every view of the column, which only moves
+ * its first row and size. Missing values are marked
+ * in a bitmap that is only allocated if there are any
+ ****************************************************/
+class KSL_EXPORT TableColumn
+{
+public:
+
+    enum Type {
+        Integer,
+        Real,
+        Text
+    };
+
+
+    TableColumn();
+
+    // NaNs are missing values
+    TableColumn(const Array<1> &reals);
+
+    TableColumn(const Array<1,int> &ints);
+
+    // Each row holds the index of its text in categories,
+    // -1 being a missing value
+    TableColumn(const Array<1,int> &codes, const QVector<QString> &categories);
+
+    // Null strings are missing values
+    TableColumn(const QVector<QString> &texts);
+
+
+    Type type() const { return m_type; }
+
+    int size() const { return m_size; }
+
+    bool isNull(int row) const {
+        if (!m_nulls.size())
+            return false;
+        int bit = m_offset + row;
+        return (m_nulls[bit >> 6] >> (bit & 63)) & 1;
+    }
+
+    int nullCount() const;
+
+    // Texts that are not numbers and missing values give NaN
+    double real(int row) const;
+
+    QString text(int row) const;
+
+    // The values of Real and Integer columns, and the codes of
+    // categorical Text columns, starting at the first row of
+    // the view. nullptr for the other types
+    const double* reals() const;
+
+    const int* ints() const;
+
+    bool isCategorical() const { return m_type == Text && m_ints.size() > 0; }
+
+    // The categories of a categorical column, or else the texts
+    // of the rows of the column the view was made from
+    const QVector<QString>& strings() const { return m_strings; }
+
+    // Rows [begin, begin+size) of the column, sharing its values
+    TableColumn slice(int begin, int size) const;
+
+    // Shares the values of a Real column that is not a slice,
+    // other columns are converted
+    Array<1> array() const;
+
+
+private:
+
+    void findNulls();
+
+    Type m_type;
+    int m_offset;
+    int m_size;
+    Array<1> m_reals;
+    Array<1,int> m_ints;
+    QVector<QString> m_strings;
+    Array<1,quint64> m_nulls;
+};
+
+
+/****************************************************
+ * Named, typed columns of the same size. Selecting
+ * columns and slicing rows give views that share the
+ * values of the table, nothing is copied
+ ****************************************************/
+class KSL_EXPORT Table
+{
+public:
+
+    Table();
+
+
+    int rows() const { return m_rows; }
+
+    int cols() const { return m_columns.size(); }
+
+    bool empty() const { return m_columns.isEmpty(); }
+
+    QStringList keys() const { return m_keys; }
+
+    int indexOf(const QString &key) const { return m_keys.indexOf(key); }
+
+    // Adds a column, which must have as many rows as the others
+    bool append(const QString &key, const TableColumn &column);
+
+    const TableColumn& column(const QString &key) const;
+
+    const TableColumn& column(int index) const { return m_columns[index]; }
+
+    TableColumn::Type columnType(const QString &key) const;
+
+    TableColumn::Type columnType(int index) const { return m_columns[index].type(); }
+
+    Table select(const QStringList &keys) const;
+
+    Table select(const Array<1,int> &indexes) const;
+
+    Table slice(int begin, int rows) const;
+
+    Array<1> array(const QString &key) const;
+
+    Array<1> array(int index) const { return m_columns[index].array(); }
+
+    Array<2> matrix() const;
+
+    void fillcol(Array<2> &a, int j, const QString &key) const;
+
+    void fillcol(Array<2> &a, int j, int col) const;
+
+
+private:
+
+    QStringList m_keys;
+    QVector<TableColumn> m_columns;
+    int m_rows;
+};
+
+} // namespace Ksl
+
+#endif // KSL_TABLE_H
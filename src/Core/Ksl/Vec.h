@@ -0,0 +1,359 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KSL_VEC_H
+#define KSL_VEC_H
+
+#include <Ksl/Math.h>
+#include <ostream>
+#include <initializer_list>
+
+namespace Ksl {
+
+/***************************************************
+ * Calls f(0), f(1), ..., f(N-1) with the loop
+ * expanded at compile time
+ **************************************************/
+template <int N>
+struct Unroll {
+    template <typename Func>
+    static inline void apply(Func f) {
+        Unroll<N-1>::apply(f);
+        f(N-1);
+    }
+};
+
+template <>
+struct Unroll<0> {
+    template <typename Func>
+    static inline void apply(Func) { }
+};
+
+
+/*********************************************
+ * Fixed size vector stored in place. Unlike
+ * Array<1> it never touches the allocator
+ *********************************************/
+template <int N, typename Tp=double>
+class Vec
+{
+public:
+
+    Vec() { }
+
+    explicit Vec(const Tp &initValue) {
+        Unroll<N>::apply([&](int k) { m_data[k] = initValue; });
+    }
+
+    Vec(std::initializer_list<Tp> initList) {
+        int k = 0;
+        for (auto &x : initList) {
+            if (k == N) break;
+            m_data[k++] = x;
+        }
+        while (k < N) {
+            m_data[k++] = Tp(0);
+        }
+    }
+
+    static constexpr int size() { return N; }
+
+    Tp& operator[] (int idx) { return m_data[idx]; }
+    const Tp& operator[] (int idx) const { return m_data[idx]; }
+
+    Tp* begin() { return m_data; }
+    const Tp* begin() const { return m_data; }
+
+    Tp* end() { return m_data + N; }
+    const Tp* end() const { return m_data + N; }
+
+    Vec& operator+= (const Vec &that) {
+        Unroll<N>::apply([&](int k) { m_data[k] += that.m_data[k]; });
+        return *this;
+    }
+
+    Vec& operator-= (const Vec &that) {
+        Unroll<N>::apply([&](int k) { m_data[k] -= that.m_data[k]; });
+        return *this;
+    }
+
+    Vec& operator*= (const Tp &factor) {
+        Unroll<N>::apply([&](int k) { m_data[k] *= factor; });
+        return *this;
+    }
+
+    Vec& operator/= (const Tp &factor) {
+        Unroll<N>::apply([&](int k) { m_data[k] /= factor; });
+        return *this;
+    }
+
+
+private:
+
+    Tp m_data[N];
+};
+
+
+template <int N, typename Tp> inline Vec<N,Tp>
+operator+ (Vec<N,Tp> v1, const Vec<N,Tp> &v2) {
+    return v1 += v2;
+}
+
+
+template <int N, typename Tp> inline Vec<N,Tp>
+operator- (Vec<N,Tp> v1, const Vec<N,Tp> &v2) {
+    return v1 -= v2;
+}
+
+
+template <int N, typename Tp> inline Vec<N,Tp>
+operator- (Vec<N,Tp> v) {
+    Unroll<N>::apply([&](int k) { v[k] = -v[k]; });
+    return v;
+}
+
+
+template <int N, typename Tp> inline Vec<N,Tp>
+operator* (Vec<N,Tp> v, const Tp &factor) {
+    return v *= factor;
+}
+
+
+template <int N, typename Tp> inline Vec<N,Tp>
+operator* (const Tp &factor, Vec<N,Tp> v) {
+    return v *= factor;
+}
+
+
+template <int N, typename Tp> inline Vec<N,Tp>
+operator/ (Vec<N,Tp> v, const Tp &factor) {
+    return v /= factor;
+}
+
+
+template <int N, typename Tp> inline bool
+operator== (const Vec<N,Tp> &v1, const Vec<N,Tp> &v2) {
+    for (int k=0; k<N; ++k) {
+        if (v1[k] != v2[k]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+template <int N, typename Tp> inline bool
+operator!= (const Vec<N,Tp> &v1, const Vec<N,Tp> &v2) {
+    return !(v1 == v2);
+}
+
+
+template <int N, typename Tp> inline Tp
+dot(const Vec<N,Tp> &v1, const Vec<N,Tp> &v2) {
+    Tp ret = Tp(0);
+    Unroll<N>::apply([&](int k) { ret += v1[k]*v2[k]; });
+    return ret;
+}
+
+
+template <int N, typename Tp> inline Tp
+norm(const Vec<N,Tp> &v) {
+    return std::sqrt(dot(v, v));
+}
+
+
+template <typename Tp> inline Vec<3,Tp>
+cross(const Vec<3,Tp> &v1, const Vec<3,Tp> &v2) {
+    return Vec<3,Tp>{
+        v1[1]*v2[2] - v1[2]*v2[1],
+        v1[2]*v2[0] - v1[0]*v2[2],
+        v1[0]*v2[1] - v1[1]*v2[0]
+    };
+}
+
+
+template <int N, typename Tp> inline std::ostream&
+operator<< (std::ostream &out, const Vec<N,Tp> &v) {
+    out << '[';
+    for (int k=0; k<N-1; ++k) {
+        out << v[k] << ", ";
+    }
+    if (N > 0) out << v[N-1];
+    out << ']';
+    return out;
+}
+
+
+/*********************************************
+ * Fixed size M x N matrix stored in place,
+ * in row major order
+ *********************************************/
+template <int M, int N, typename Tp=double>
+class Mat
+{
+public:
+
+    Mat() { }
+
+    explicit Mat(const Tp &initValue) {
+        Unroll<M*N>::apply([&](int k) { m_data[k] = initValue; });
+    }
+
+    Mat(std::initializer_list<std::initializer_list<Tp>> initList) {
+        int i = 0;
+        for (auto &row : initList) {
+            if (i == M) break;
+            int j = 0;
+            for (auto &x : row) {
+                if (j == N) break;
+                m_data[i*N + j++] = x;
+            }
+            while (j < N) {
+                m_data[i*N + j++] = Tp(0);
+            }
+            ++i;
+        }
+        for (int k=i*N; k<M*N; ++k) {
+            m_data[k] = Tp(0);
+        }
+    }
+
+    static Mat identity() {
+        Mat ret(Tp(0));
+        Unroll<(M < N ? M : N)>::apply([&](int k) { ret[k][k] = Tp(1); });
+        return ret;
+    }
+
+    static constexpr int rows() { return M; }
+    static constexpr int cols() { return N; }
+    static constexpr int size() { return M*N; }
+
+    Tp* operator[] (int idx) { return m_data + idx*N; }
+    const Tp* operator[] (int idx) const { return m_data + idx*N; }
+
+    Tp& at(int idx) { return m_data[idx]; }
+    const Tp& at(int idx) const { return m_data[idx]; }
+
+    Tp* begin() { return m_data; }
+    const Tp* begin() const { return m_data; }
+
+    Tp* end() { return m_data + M*N; }
+    const Tp* end() const { return m_data + M*N; }
+
+    Mat& operator+= (const Mat &that) {
+        Unroll<M*N>::apply([&](int k) { m_data[k] += that.m_data[k]; });
+        return *this;
+    }
+
+    Mat& operator-= (const Mat &that) {
+        Unroll<M*N>::apply([&](int k) { m_data[k] -= that.m_data[k]; });
+        return *this;
+    }
+
+    Mat& operator*= (const Tp &factor) {
+        Unroll<M*N>::apply([&](int k) { m_data[k] *= factor; });
+        return *this;
+    }
+
+
+private:
+
+    Tp m_data[M*N];
+};
+
+
+template <int M, int N, typename Tp> inline Mat<M,N,Tp>
+operator+ (Mat<M,N,Tp> a, const Mat<M,N,Tp> &b) {
+    return a += b;
+}
+
+
+template <int M, int N, typename Tp> inline Mat<M,N,Tp>
+operator- (Mat<M,N,Tp> a, const Mat<M,N,Tp> &b) {
+    return a -= b;
+}
+
+
+template <int M, int N, typename Tp> inline Mat<M,N,Tp>
+operator* (Mat<M,N,Tp> a, const Tp &factor) {
+    return a *= factor;
+}
+
+
+template <int M, int N, typename Tp> inline Mat<M,N,Tp>
+operator* (const Tp &factor, Mat<M,N,Tp> a) {
+    return a *= factor;
+}
+
+
+template <int M, int N, typename Tp> inline Vec<M,Tp>
+operator* (const Mat<M,N,Tp> &a, const Vec<N,Tp> &v) {
+    Vec<M,Tp> ret;
+    Unroll<M>::apply([&](int i) {
+        Tp sum = Tp(0);
+        Unroll<N>::apply([&](int j) { sum += a[i][j]*v[j]; });
+        ret[i] = sum;
+    });
+    return ret;
+}
+
+
+template <int M, int N, int P, typename Tp> inline Mat<M,P,Tp>
+operator* (const Mat<M,N,Tp> &a, const Mat<N,P,Tp> &b) {
+    Mat<M,P,Tp> ret;
+    Unroll<M>::apply([&](int i) {
+        Unroll<P>::apply([&](int j) {
+            Tp sum = Tp(0);
+            Unroll<N>::apply([&](int k) { sum += a[i][k]*b[k][j]; });
+            ret[i][j] = sum;
+        });
+    });
+    return ret;
+}
+
+
+template <int M, int N, typename Tp> inline Mat<N,M,Tp>
+transpose(const Mat<M,N,Tp> &a) {
+    Mat<N,M,Tp> ret;
+    Unroll<M>::apply([&](int i) {
+        Unroll<N>::apply([&](int j) { ret[j][i] = a[i][j]; });
+    });
+    return ret;
+}
+
+
+template <int M, int N, typename Tp> inline std::ostream&
+operator<< (std::ostream &out, const Mat<M,N,Tp> &a) {
+    out << "[[";
+    for (int i=0; i<M; ++i) {
+        if (i != 0) out << " [";
+        for (int j=0; j<N-1; ++j) {
+            out << a[i][j] << ", ";
+        }
+        if (N > 0) out << a[i][N-1];
+        if (i < (M-1)) out << ']' << std::endl;
+    }
+    out << "]]";
+    return out;
+}
+
+} // namespace Ksl
+
+#endif // KSL_VEC_H
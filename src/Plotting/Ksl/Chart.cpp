@@ -130,6 +130,18 @@ Plot* Chart::plot(const Array<1> &y,
 }
 
 
+Plot* Chart::plot(const Table &table,
+                  const QString &xKey,
+                  const QString &yKey,
+                  const char *style,
+                  const QString &name,
+                  const QString &scaleName)
+{
+    return plot(table.array(xKey), table.array(yKey), style,
+                name.isEmpty() ? yKey : name, scaleName);
+}
+
+
 TextPlot* Chart::text(const QString &text, const QPointF &pos,
                       const QColor &stroke, float rotation,
                       const QString &scaleName)
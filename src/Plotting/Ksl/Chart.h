@@ -30,6 +30,7 @@
 #include <Ksl/LinePlot.h>
 #include <Ksl/PolyPlot.h>
 #include <Ksl/FeaturePlot.h>
+#include <Ksl/Table.h>
 
 namespace Ksl {
 
@@ -59,6 +60,13 @@ public:
                const QString &name="",
                const QString &scaleName="xy-scale");
 
+    // Plots column yKey against column xKey, named
+    // yKey unless a name is given
+    Plot* plot(const Table &table, const QString &xKey, const QString &yKey,
+               const char *style="kor",
+               const QString &name="",
+               const QString &scaleName="xy-scale");
+
     TextPlot* text(const QString &text, const QPointF &pos,
                    const QColor &stroke=Qt::blue, float rotation=0.0,
                    const QString &scaleName="xy-scale");
@@ -56,26 +56,42 @@ void PolyPlot::setLimits(double xMin, double xMax) {
 }
 
 
+void PolyPlot::setPointCount(int pointCount) {
+    KSL_PUBLIC(PolyPlot);
+    if (pointCount < 2)
+        return;
+    m->pointCount = pointCount;
+    m->updateData();
+    emit appearenceChanged(this);
+}
+
+
 void PolyPlotPrivate::updateData() {
-    if (a.size() == 0 || xMin >= xMax)
+    if (a.size() == 0 || xMin >= xMax || pointCount < 2)
         return;
 
-    // create arrays
-    double dx = (xMax-xMin)/pointCount;
-    x = linspace(xMin, xMax, dx);
-    y = zeros(x.size());
+    // reuse the sample buffers between updates
+    if (xData.size() != pointCount) {
+        xData = Array<1>(pointCount);
+        yData = Array<1>(pointCount);
+    }
+
+    // create samples
+    double dx = (xMax-xMin)/(pointCount-1);
+    for (int k=0; k<pointCount; ++k)
+        xData[k] = xMin + k*dx;
 
     // calculate functional values
-    for (int k=0; k<pointCount; ++k) {
-        //y[k] = poly(a, x[k]);
-    }
+    polyval(a, xData.begin(), yData.begin(), pointCount);
+    x = xData;
+    y = yData;
 
     // set data ranges
-    yMin = y[0];
-    yMax = y[0];
+    yMin = yData[0];
+    yMax = yData[0];
     for (int k=1; k<pointCount; ++k) {
-        if (y[k] < yMin) yMin = y[k];
-        if (y[k] > yMax) yMax = y[k];
+        if (yData[k] < yMin) yMin = yData[k];
+        if (yData[k] > yMax) yMax = yData[k];
     }
 }
 
@@ -45,6 +45,8 @@ public slots:
     void setParametes(const Array<1> &a);
 
     void setLimits(double xMin, double xMax);
+
+    void setPointCount(int pointCount);
 };
 
 } // namespace Ksl
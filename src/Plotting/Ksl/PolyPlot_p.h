@@ -51,6 +51,8 @@ public:
 
     void updateData();
     Array<1> a;
+    Array<1> xData;
+    Array<1> yData;
 };
 
 } // namespace Ksl
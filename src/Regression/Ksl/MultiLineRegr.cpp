@@ -58,6 +58,14 @@ MultiLineRegr::MultiLineRegr(const Csv &csv, const Array<1,int> &columns,
 }
 
 
+MultiLineRegr::MultiLineRegr(const Table &table, const Array<1,int> &columns,
+                             int yCol)
+    : Ksl::Object(new MultiLineRegrPrivate(this))
+{
+    fit(table, columns, yCol);
+}
+
+
 MultiLineRegrPrivate::~MultiLineRegrPrivate() {
     if (workspace)
         gsl_multifit_linear_free(workspace);
@@ -128,17 +136,14 @@ void MultiLineRegr::fit(const Array<2> &X, const Array<1> &y,
 void MultiLineRegr::fit(const Csv &csv, const Array<1,int> &columns,
                         const Array<1> &y)
 {
-
-    // File containing data
-    auto DATA = csv.matrix();
-    int N = DATA.rows();
-
-    // fill matrix with params
+    // fill matrix with params, converting only
+    // the columns that take part in the fit
+    int N = csv.rows();
     Array<2> X(N, columns.size()+1);
-    X.set_col(0, 1.0);
-    for (int j=0; j<columns.size(); ++j) {
-        X.col_to_col(j+1, DATA, columns[j]);
-    }
+    for (int i=0; i<N; ++i)
+        X[i][0] = 1.0;
+    for (int j=0; j<columns.size(); ++j)
+        csv.fillcol(X, j+1, columns[j]);
 
     // Perform regression
     fit(X, y);
@@ -147,20 +152,27 @@ void MultiLineRegr::fit(const Csv &csv, const Array<1,int> &columns,
 
 void MultiLineRegr::fit(const Csv &csv, const Array<1,int> &columns, int yCol)
 {
-    // File containing data
-    auto DATA = csv.matrix();
-    int N = DATA.rows();
-    auto Y = col(DATA, yCol);
+    fit(csv, columns, csv.array(yCol));
+}
 
-    // fill matrix with params
+
+void MultiLineRegr::fit(const Table &table, const Array<1,int> &columns,
+                        const Array<1> &y)
+{
+    int N = table.rows();
     Array<2> X(N, columns.size()+1);
-    X.set_col(0, 1.0);
-    for (int j=0; j<columns.size(); ++j) {
-        X.col_to_col(j+1, DATA, columns[j]);
-    }
+    for (int i=0; i<N; ++i)
+        X[i][0] = 1.0;
+    for (int j=0; j<columns.size(); ++j)
+        table.fillcol(X, j+1, columns[j]);
 
-    // Perform regression
-    fit(X, Y);
+    fit(X, y);
+}
+
+
+void MultiLineRegr::fit(const Table &table, const Array<1,int> &columns, int yCol)
+{
+    fit(table, columns, table.array(yCol));
 }
 
 
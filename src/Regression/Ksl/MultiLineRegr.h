@@ -41,6 +41,8 @@ public:
 
     MultiLineRegr(const Csv &csv, const Array<1,int> &columns, int yCol);
 
+    MultiLineRegr(const Table &table, const Array<1,int> &columns, int yCol);
+
 
     void fit(const Array<2> &X, const Array<1> &y);
 
@@ -50,6 +52,10 @@ public:
 
     void fit(const Csv &csv, const Array<1,int> &columns, int yCol);
 
+    void fit(const Table &table, const Array<1,int> &columns, const Array<1> &y);
+
+    void fit(const Table &table, const Array<1,int> &columns, int yCol);
+
 
     double model(int idx) const;
 
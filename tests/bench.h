@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Helpers shared by the benchmark programs
+
+#ifndef KSL_TESTS_BENCH_H
+#define KSL_TESTS_BENCH_H
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+inline double seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+
+// Cheap random numbers, so that the code measured dominates
+inline uint32_t xorshift(uint32_t &state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+inline uint64_t xorshift(uint64_t &state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+
+// Prints what failed, the programs return 1 if any check did
+inline bool check(bool ok, const char *what) {
+    if (!ok)
+        std::cout << "FAILED: " << what << std::endl;
+    return ok;
+}
+
+#endif // KSL_TESTS_BENCH_H
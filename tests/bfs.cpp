@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Ksl/Bfs.h>
+#include <Ksl/GraphBuilder.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "bench.h"
+
+using namespace Ksl;
+
+// Edge lists of an R-MAT graph with 2^scale vertices. Each edge falls in one of the
+// quadrants of the adjacency matrix with probabilities a, b,
+// c and 1-a-b-c, recursively, which gives the skewed degrees
+// of real networks
+static void rmat(int scale, int edges, Array<1,int> &sources, Array<1,int> &targets) {
+    const double a = 0.57, b = 0.19, c = 0.19;
+    sources = Array<1,int>(edges);
+    targets = Array<1,int>(edges);
+    uint64_t state = 88172645463325252ull;
+    for (int e=0; e<edges; ++e) {
+        int u = 0, v = 0;
+        for (int bit=0; bit<scale; ++bit) {
+            double r = double(xorshift(state) >> 11) / double(uint64_t(1) << 53);
+            if (r < a) { }
+            else if (r < a + b) { v |= 1 << bit; }
+            else if (r < a + b + c) { u |= 1 << bit; }
+            else { u |= 1 << bit; v |= 1 << bit; }
+        }
+        sources[e] = u;
+        targets[e] = v;
+    }
+}
+
+
+// A graph in compressed sparse row layout
+struct Csr {
+    uint32_t count;
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> targets;
+    std::vector<uint32_t> edgeIndex;
+};
+
+
+// Plain counting sort by source, each edge of the lists
+// first, then each edge the other way, to check against
+static Csr symmetric(uint32_t count, const Array<1,int> &sources, const Array<1,int> &targets) {
+    const uint32_t edges = uint32_t(sources.size());
+    Csr csr;
+    csr.count = count;
+    csr.offsets.assign(count + 1, 0);
+    for (uint32_t e=0; e<edges; ++e) {
+        csr.offsets[sources[e] + 1] += 1;
+        csr.offsets[targets[e] + 1] += 1;
+    }
+    for (uint32_t v=0; v<count; ++v)
+        csr.offsets[v+1] += csr.offsets[v];
+    csr.targets.resize(2*uint64_t(edges));
+    csr.edgeIndex.resize(2*uint64_t(edges));
+    std::vector<uint64_t> pos(csr.offsets.begin(), csr.offsets.end() - 1);
+    for (uint32_t e=0; e<edges; ++e) {
+        csr.edgeIndex[pos[sources[e]]] = e;
+        csr.targets[pos[sources[e]]++] = targets[e];
+    }
+    for (uint32_t e=0; e<edges; ++e) {
+        csr.edgeIndex[pos[targets[e]]] = edges + e;
+        csr.targets[pos[targets[e]]++] = sources[e];
+    }
+    return csr;
+}
+
+
+// The same, each edge only as it is in the lists
+static Csr directed(uint32_t count, const Array<1,int> &sources, const Array<1,int> &targets) {
+    const uint32_t edges = uint32_t(sources.size());
+    Csr csr;
+    csr.count = count;
+    csr.offsets.assign(count + 1, 0);
+    for (uint32_t e=0; e<edges; ++e)
+        csr.offsets[sources[e] + 1] += 1;
+    for (uint32_t v=0; v<count; ++v)
+        csr.offsets[v+1] += csr.offsets[v];
+    csr.targets.resize(edges);
+    std::vector<uint64_t> pos(csr.offsets.begin(), csr.offsets.end() - 1);
+    for (uint32_t e=0; e<edges; ++e)
+        csr.targets[pos[sources[e]]++] = targets[e];
+    return csr;
+}
+
+
+static bool same(const Csr &csr, const GraphBuilder &graph) {
+    if (graph.vertexCount() != csr.count || graph.edgeCount() != csr.targets.size())
+        return false;
+    return std::equal(csr.offsets.begin(), csr.offsets.end(), graph.offsets())
+        && std::equal(csr.targets.begin(), csr.targets.end(), graph.targets())
+        && std::equal(csr.edgeIndex.begin(), csr.edgeIndex.end(), graph.edgeIndex());
+}
+
+
+// Plain queue based search, to check against
+static std::vector<int> reference(const Csr &csr, uint32_t source) {
+    const uint64_t *offsets = csr.offsets.data();
+    const uint32_t *targets = csr.targets.data();
+    std::vector<int> distances(csr.count, -1);
+    std::vector<uint32_t> queue(1, source);
+    distances[source] = 0;
+    for (size_t k=0; k<queue.size(); ++k) {
+        uint32_t u = queue[k];
+        for (uint64_t e=offsets[u]; e<offsets[u+1]; ++e) {
+            uint32_t v = targets[e];
+            if (distances[v] < 0) {
+                distances[v] = distances[u] + 1;
+                queue.push_back(v);
+            }
+        }
+    }
+    return distances;
+}
+
+
+int main(int argc, char *argv[]) {
+    const int scale = argc > 1 ? std::atoi(argv[1]) : 20;
+    const int edgeFactor = argc > 2 ? std::atoi(argv[2]) : 16;
+
+    // the lists are Array<1,int>, and hold each edge once
+    const uint64_t edges = (scale < 1 || scale > 30 || edgeFactor < 1) ? 0
+        : (uint64_t(1) << scale) * uint64_t(edgeFactor);
+    if (edges == 0 || edges > uint64_t(std::numeric_limits<int>::max())) {
+        std::cout << "scale " << scale << " with edge factor " << edgeFactor
+                  << " does not fit the edge lists" << std::endl;
+        return 1;
+    }
+    Array<1,int> sources, targets;
+    rmat(scale, int(edges), sources, targets);
+    const uint32_t count = uint32_t(1) << scale;
+    const Csr csr = symmetric(count, sources, targets);
+
+    // each edge both ways
+    GraphBuilder graph;
+    graph.setSymmetric(true);
+    bool ok = true;
+    for (bool parallel : { false, true }) {
+        graph.setParallel(parallel);
+        auto start = std::chrono::steady_clock::now();
+        graph.build(sources, targets, count);
+        const double time = seconds(start);
+        const bool built = check(same(csr, graph), "GraphBuilder layout");
+        ok = ok && built;
+        std::cout << "R-MAT scale " << scale << ", " << graph.vertexCount() << " vertices, "
+                  << graph.edgeCount() << " edges, built in " << time << " s"
+                  << (parallel ? " in parallel" : "")
+                  << (built ? "" : ", WRONG LAYOUT") << std::endl;
+    }
+    const uint64_t *offsets = graph.offsets();
+
+    // start from the vertex of highest degree, which is in
+    // the giant component
+    uint32_t source = 0;
+    for (uint32_t v=1; v<count; ++v) {
+        if (offsets[v+1] - offsets[v] > offsets[source+1] - offsets[source])
+            source = v;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<int> expected = reference(csr, source);
+    double referenceTime = seconds(start);
+    std::cout << "queue BFS                 " << referenceTime << " s" << std::endl;
+
+    struct Setup { const char *name; double alpha; bool parallel; };
+    const Setup setups[] = {
+        { "Bfs top-down              ", 0.0, false },
+        { "Bfs direction-optimising  ", 15.0, false },
+        { "Bfs parallel              ", 15.0, true }
+    };
+    for (const Setup &setup : setups) {
+        Bfs bfs;
+        bfs.setSymmetric(true);
+        bfs.setAlpha(setup.alpha);
+        bfs.setParallel(setup.parallel);
+        start = std::chrono::steady_clock::now();
+        bfs.run(count, offsets, graph.targets(), source);
+        double time = seconds(start);
+
+        Array<1,int> distances = bfs.distances();
+        bool right = true;
+        for (uint32_t v=0; v<count; ++v)
+            right = right && distances[int(v)] == expected[v];
+        ok = check(right, setup.name) && ok;
+        std::cout << setup.name << time << " s (" << referenceTime / time << "x), "
+                  << bfs.depth() << " levels, " << bfs.bottomUpSteps() << " bottom-up"
+                  << (right ? "" : ", WRONG DISTANCES") << std::endl;
+    }
+
+    // one way edges go bottom-up on the transpose, kept between
+    // runs on the same graph and built again for another one
+    const Csr forward = directed(count, sources, targets);
+    const Csr backward = directed(count, targets, sources);
+    Bfs bfs;
+    bfs.setAlpha(15.0);
+    bfs.setParallel(true);
+    for (const Csr *csr : { &forward, &forward, &backward }) {
+        start = std::chrono::steady_clock::now();
+        bfs.run(count, csr->offsets.data(), csr->targets.data(), source);
+        double time = seconds(start);
+
+        expected = reference(*csr, source);
+        Array<1,int> distances = bfs.distances();
+        bool right = true;
+        for (uint32_t v=0; v<count; ++v)
+            right = right && distances[int(v)] == expected[v];
+        ok = check(right, "Bfs directed") && ok;
+        std::cout << "Bfs directed              " << time << " s, "
+                  << bfs.depth() << " levels, " << bfs.bottomUpSteps() << " bottom-up"
+                  << (right ? "" : ", WRONG DISTANCES") << std::endl;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Ksl/Csv.h>
+#include <Ksl/CsvReader.h>
+#include <QDir>
+#include <QFile>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+#include "bench.h"
+
+using namespace Ksl;
+
+// Quotes only matter at the start of a field: a quote inside a
+// field is a character like any other, a field that starts with
+// one may hold delimiters, newlines and "" for a quote
+static const char Block[] =
+    "a\"b,1,plain\n"
+    "5'11\",2,\"two\nlines, one field\"\n"
+    "c,3,\"say \"\"hi\"\"\" # comment\n";
+
+static const int BlockRows = 3;
+
+
+static bool checkRows(const Csv &csv, int blocks) {
+    if (csv.rows() != blocks * BlockRows || csv.cols() != 3)
+        return false;
+    const QVector<QString> &names = csv.column("name");
+    const Array<1> &heights = csv.array("height");
+    const QVector<QString> &notes = csv.column("note");
+    for (int b=0; b<blocks; ++b) {
+        const int row = b * BlockRows;
+        if (names[row] != QString("a\"b") || names[row+1] != QString("5'11\"")
+            || notes[row+1] != QString("two\nlines, one field")
+            || notes[row+2] != QString("say \"hi\""))
+            return false;
+        for (int k=0; k<BlockRows; ++k) {
+            if (heights[row+k] != k + 1)
+                return false;
+        }
+    }
+    return true;
+}
+
+
+int main(int argc, char *argv[]) {
+    const int blocks = argc > 1 ? std::atoi(argv[1]) : 100000;
+    const QString path = QDir::tempPath() + "/ksl_csv.csv";
+    {
+        std::ofstream out(path.toLocal8Bit().constData());
+        out << "name,height,note\n";
+        for (int b=0; b<blocks; ++b)
+            out << Block;
+    }
+
+    Csv serial(path, true, ',');
+    bool ok = check(checkRows(serial, blocks), "Csv");
+
+    Csv parallel;
+    parallel.setParallel(true);
+    parallel.readAll(path, true, ',');
+    ok = check(checkRows(parallel, blocks), "Csv parallel") && ok;
+
+    // the reader streams, so it never holds much of the file
+    CsvReader reader(path, true, ',');
+    Array<2> batch;
+    qint64 rows = 0;
+    bool right = reader.cols() == 3;
+    while (int count = reader.read(batch, 1000)) {
+        for (int k=0; k<count; ++k)
+            right = right && batch[k][1] == (rows + k) % BlockRows + 1;
+        rows += count;
+    }
+    ok = check(right && rows == qint64(blocks) * BlockRows, "CsvReader") && ok;
+
+    // reals out of the range of int are clamped
+    {
+        std::ofstream out(path.toLocal8Bit().constData());
+        out << "x\n3e9\n-1e300\n2.7\n-2.7\n";
+    }
+    Array<1,int> ints = Csv(path, true, ',').intArray(0);
+    ok = check(ints.size() == 4 && ints[0] == std::numeric_limits<int>::max()
+               && ints[1] == std::numeric_limits<int>::min()
+               && ints[2] == 2 && ints[3] == -2, "Csv::intArray") && ok;
+
+    QFile::remove(path);
+    std::cout << blocks * BlockRows << " rows" << (ok ? "" : ", WRONG ROWS") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Ksl/GroupBy.h>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "bench.h"
+
+using namespace Ksl;
+
+// Writes a file whose columns are an Integer, a categorical text,
+// a plain text with too many values to be categorical, a Real
+// with few values, and a Real and an Integer with missing values
+static void writeFile(const QString &path, int rows) {
+    std::ofstream out(path.toLocal8Bit().constData());
+    const char *kinds[] = { "apple", "pear", "plum", "fig", "" };
+    out << "store,kind,name,w,price,qty\n";
+    uint32_t state = 42;
+    for (int k=0; k<rows; ++k) {
+        const uint32_t r = xorshift(state);
+        out << (r % 50) << ',' << kinds[(r >> 8) % 5] << ",n" << ((r >> 4) % 100000)
+            << ',' << 0.5 * ((r >> 12) % 37) << ',';
+        if ((r >> 20) % 10 != 0)
+            out << 0.01 * ((r >> 7) % 100000);
+        out << ',' << ((r >> 16) % 100) << '\n';
+    }
+}
+
+
+// The values of one group, gathered row by row
+struct Group {
+    int rows;
+    std::vector<double> values;
+    double sum;
+};
+
+
+// Groups the rows by the text of the key columns, in the order
+// they first appear, gathering value, and compares with result.
+// Each aggregate of result is named after its function
+static bool compare(const Csv &csv, const QStringList &keys, const QString &value,
+                    const Csv &result)
+{
+    const QString separator("\x1f");
+    QHash<QString,int> index;
+    QStringList order;
+    std::vector<Group> groups;
+    const Array<1> &values = csv.array(value);
+    for (int i=0; i<csv.rows(); ++i) {
+        QString key;
+        for (const QString &column : keys)
+            key += csv.column(column)[i] + separator;
+        int at = index.value(key, -1);
+        if (at < 0) {
+            at = int(groups.size());
+            index.insert(key, at);
+            order.append(key);
+            groups.push_back(Group{ 0, {}, 0.0 });
+        }
+        Group &group = groups[at];
+        group.rows += 1;
+        if (!std::isnan(values[i])) {
+            group.values.push_back(values[i]);
+            group.sum += values[i];
+        }
+    }
+    if (result.rows() != int(groups.size()) || result.cols() != keys.size() + 8)
+        return false;
+
+    auto close = [](double x, double y) {
+        if (std::isnan(x) || std::isnan(y))
+            return std::isnan(x) && std::isnan(y);
+        return std::fabs(x - y) <= 1e-9 * qMax(1.0, std::fabs(y));
+    };
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const int first = keys.size();
+    for (int g=0; g<result.rows(); ++g) {
+        QString key;
+        for (int j=0; j<keys.size(); ++j)
+            key += result.column(j)[g] + separator;
+        if (key != order[g])
+            return false;
+
+        const Group &group = groups[g];
+        const int count = int(group.values.size());
+        const double mean = count > 0 ? group.sum / count : nan;
+        double min = count > 0 ? group.values[0] : nan, max = min, squares = 0.0;
+        for (double x : group.values) {
+            min = qMin(min, x);
+            max = qMax(max, x);
+            squares += (x - mean) * (x - mean);
+        }
+        const double variance = count > 1 ? squares / (count - 1) : nan;
+        const bool right = result.intArray(first)[g] == group.rows
+            && result.intArray(first + 1)[g] == count
+            && close(result.array(first + 2)[g], group.sum)
+            && close(result.array(first + 3)[g], mean)
+            && close(result.array(first + 4)[g], min)
+            && close(result.array(first + 5)[g], max)
+            && close(result.array(first + 6)[g], variance)
+            && close(result.array(first + 7)[g], std::sqrt(variance));
+        if (!right)
+            return false;
+    }
+    return true;
+}
+
+
+int main(int argc, char *argv[]) {
+    const int rows = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    const QString path = QDir::tempPath() + "/ksl_groupby.csv";
+    writeFile(path, rows);
+    Csv csv(path, true, ',');
+    QFile::remove(path);
+    bool ok = check(csv.rows() == rows, "rows read");
+    ok = check(csv.columnType("store") == Csv::Integer && csv.isCategorical("kind")
+               && !csv.isCategorical("name") && csv.columnType("w") == Csv::Real,
+               "column types") && ok;
+    std::cout << rows << " rows" << std::endl;
+
+    struct Setup { const char *name; QStringList keys; const char *value; };
+    const Setup setups[] = {
+        { "Integer and categorical keys ", QStringList{ "store", "kind" }, "price" },
+        { "Real key                     ", QStringList{ "w" }, "qty" },
+        { "plain text key               ", QStringList{ "name" }, "price" },
+        { "no key                       ", QStringList(), "price" }
+    };
+    for (const Setup &setup : setups) {
+        GroupBy groupBy(setup.keys);
+        groupBy.addAggregate(GroupBy::Count, QString(), "count");
+        groupBy.addAggregate(GroupBy::Count, setup.value, "values");
+        groupBy.addAggregate(GroupBy::Sum, setup.value, "sum");
+        groupBy.addAggregate(GroupBy::Mean, setup.value, "mean");
+        groupBy.addAggregate(GroupBy::Min, setup.value, "min");
+        groupBy.addAggregate(GroupBy::Max, setup.value, "max");
+        groupBy.addAggregate(GroupBy::Variance, setup.value, "var");
+        groupBy.addAggregate(GroupBy::StdDev, setup.value, "sd");
+
+        for (bool parallel : { false, true }) {
+            groupBy.setParallel(parallel);
+            Csv result;
+            auto start = std::chrono::steady_clock::now();
+            bool applied = groupBy.apply(csv, result);
+            double time = seconds(start);
+            bool right = check(applied && compare(csv, setup.keys, setup.value, result),
+                               setup.name);
+            ok = ok && right;
+            std::cout << setup.name << (parallel ? "parallel " : "serial   ") << time
+                      << " s, " << result.rows() << " groups"
+                      << (right ? "" : ", WRONG GROUPS") << std::endl;
+        }
+    }
+
+    GroupBy missing(QStringList{ "nope" });
+    Csv result;
+    ok = check(!missing.apply(csv, result), "missing key refused") && ok;
+    return ok ? 0 : 1;
+}
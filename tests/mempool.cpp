@@ -0,0 +1,127 @@
+#include <Ksl/Graph.h>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "bench.h"
+
+using namespace Ksl;
+
+typedef GraphVertex<int,double> Vertex;
+typedef GraphEdge<int,double> Edge;
+
+// A block that is alive and the size it was allocated with
+struct Live {
+    void *ptr;
+    uint64_t size;
+};
+
+
+// Allocates and frees vertices and edges in random order, keeping
+// at most `window` of them alive, and calls report() before the
+// survivors are freed
+template <typename Alloc, typename Free, typename Report>
+static double churn(int ops, int window, Alloc alloc, Free free, Report report) {
+    std::vector<Live> live;
+    live.reserve(window);
+    uint32_t state = 42;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int k=0; k<ops; ++k) {
+        uint32_t r = xorshift(state);
+        if (live.size() < size_t(window) && (live.empty() || r % 3 != 0)) {
+            uint64_t size = (r & 8) ? sizeof(Vertex) : sizeof(Edge);
+            live.push_back({ alloc(size), size });
+        }
+        else {
+            size_t victim = (r >> 4) % live.size();
+            free(live[victim].ptr, live[victim].size);
+            live[victim] = live.back();
+            live.pop_back();
+        }
+    }
+    report();
+    for (auto &block : live)
+        free(block.ptr, block.size);
+    return seconds(start);
+}
+
+
+// Blocks honour the alignment asked for, and rewind() gives
+// back what was taken after the mark
+static bool checkPool() {
+    MemoryPool pool(1 << 16, 64);
+    bool ok = true;
+    for (uint64_t alignment : { uint64_t(16), uint64_t(64), uint64_t(4096) }) {
+        for (uint64_t size : { uint64_t(8), uint64_t(200), uint64_t(1 << 20) }) {
+            void *ptr = pool.allocBytes(size, alignment);
+            ok = check(uintptr_t(ptr) % alignment == 0, "aligned block") && ok;
+            pool.freeBytes(ptr, size, alignment);
+        }
+    }
+    struct alignas(64) Line { char bytes[64]; };
+    Line *lines = pool.allocArray<Line>(10);
+    ok = check(uintptr_t(lines) % alignof(Line) == 0, "aligned array") && ok;
+    pool.freeArray(lines, 10);
+    ok = check(pool.usedBytes() == 0, "used bytes after aligned blocks") && ok;
+
+    // blocks freed before the mark are found again after it
+    pool.allocBytes(100);
+    void *freed[4];
+    for (auto &ptr : freed)
+        ptr = pool.allocBytes(48);
+    for (auto ptr : freed)
+        pool.freeBytes(ptr, 48);
+    const uint64_t used = pool.usedBytes();
+    const uint64_t cached = pool.freeListBytes();
+    {
+        MemoryPool::Scope scope(&pool);
+        for (int k=0; k<10000; ++k)
+            pool.allocBytes(8 + k % 300);
+        pool.allocBytes(1 << 22);
+        pool.freeBytes(pool.allocBytes(48), 48);
+    }
+    ok = check(pool.usedBytes() == used, "used bytes after rewind") && ok;
+    ok = check(pool.freeListBytes() == cached && pool.largeCount() == 0,
+               "free lists after rewind") && ok;
+    bool reused = true;
+    for (int k=3; k>=0; --k)
+        reused = reused && pool.allocBytes(48) == freed[k];
+    ok = check(reused, "blocks freed before the mark reused") && ok;
+    return ok;
+}
+
+
+int main(int argc, char *argv[]) {
+    const int ops = argc > 1 ? std::atoi(argv[1]) : 20000000;
+    const int window = argc > 2 ? std::atoi(argv[2]) : 1000000;
+
+    std::cout << "vertex " << sizeof(Vertex) << " bytes, edge "
+              << sizeof(Edge) << " bytes, " << ops << " operations, "
+              << window << " live at most" << std::endl;
+
+    double mallocTime = churn(ops, window,
+        [](uint64_t size) { return std::malloc(size); },
+        [](void *ptr, uint64_t) { std::free(ptr); },
+        []() { });
+    std::cout << "malloc      " << mallocTime << " s" << std::endl;
+
+    MemoryPool pool(1 << 20, 4096);
+    double poolTime = churn(ops, window,
+        [&](uint64_t size) { return pool.allocBytes(size); },
+        [&](void *ptr, uint64_t size) { pool.freeBytes(ptr, size); },
+        [&]() {
+            std::cout << "MemoryPool reserved " << pool.reservedBytes() / 1024
+                      << " KiB, used " << pool.usedBytes() / 1024
+                      << " KiB, peak " << pool.peakBytes() / 1024
+                      << " KiB, in free lists " << pool.freeListBytes() / 1024
+                      << " KiB, fragmentation " << pool.fragmentation() << std::endl;
+        });
+    std::cout << "MemoryPool  " << poolTime << " s ("
+              << mallocTime / poolTime << "x)" << std::endl;
+
+    bool ok = check(pool.usedBytes() == 0, "used bytes after the churn");
+    ok = checkPool() && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+#include <Ksl/Graph.h>
+#include <QThread>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+
+using namespace Ksl;
+
+typedef GraphVertex<int,double> Vertex;
+typedef GraphEdge<int,double> Edge;
+
+// A block that is alive and the size it was allocated with
+struct Live {
+    void *ptr;
+    uint64_t size;
+};
+
+
+// Each thread allocates vertices and edges, and frees them in
+// random order once it holds `window` of them. Part of the blocks
+// are handed to the next thread to be freed there, as happens
+// when graphs are built by several workers
+template <typename Alloc, typename Free>
+static double run(int threads, int ops, int window, Alloc alloc, Free free) {
+    std::vector< std::vector<Live> > handoff(threads);
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (int t=0; t<threads; ++t) {
+        workers.emplace_back([&, t]() {
+            std::vector<Live> live;
+            live.reserve(window);
+            uint32_t state = 1 + t;
+            for (int k=0; k<ops; ++k) {
+                uint32_t r = xorshift(state);
+                if (live.size() < size_t(window)) {
+                    uint64_t size = (r & 8) ? sizeof(Vertex) : sizeof(Edge);
+                    live.push_back({ alloc(size), size });
+                    continue;
+                }
+                size_t victim = (r >> 4) % live.size();
+                if ((r & 0xf0000) == 0)
+                    handoff[t].push_back(live[victim]);
+                else
+                    free(live[victim].ptr, live[victim].size);
+                live[victim] = live.back();
+                live.pop_back();
+            }
+            for (auto &block : live)
+                free(block.ptr, block.size);
+        });
+    }
+    for (auto &worker : workers)
+        worker.join();
+
+    // blocks freed away from the thread that allocated them
+    std::vector<std::thread> freers;
+    for (int t=0; t<threads; ++t) {
+        freers.emplace_back([&, t]() {
+            for (auto &block : handoff[(t + 1) % threads])
+                free(block.ptr, block.size);
+        });
+    }
+    for (auto &freer : freers)
+        freer.join();
+
+    return seconds(start);
+}
+
+
+int main(int argc, char *argv[]) {
+    const int ops = argc > 1 ? std::atoi(argv[1]) : 10000000;
+    const int window = argc > 2 ? std::atoi(argv[2]) : 10000;
+    const int cores = std::max(QThread::idealThreadCount(), 1);
+
+    std::cout << ops << " operations per thread, " << cores << " cores" << std::endl;
+    std::cout << "threads  malloc Mops/s  MemoryPool Mops/s" << std::endl;
+    bool ok = true;
+    for (int threads=1; threads<=cores; threads*=2) {
+        double mallocTime = run(threads, ops, window,
+            [](uint64_t size) { return std::malloc(size); },
+            [](void *ptr, uint64_t) { std::free(ptr); });
+
+        MemoryPool pool(1 << 22, 4096);
+        pool.setConcurrent(true);
+        double poolTime = run(threads, ops, window,
+            [&](uint64_t size) { return pool.allocBytes(size); },
+            [&](void *ptr, uint64_t size) { pool.freeBytes(ptr, size); });
+
+        double total = double(ops) * threads / 1e6;
+        std::cout << threads << "        " << total / mallocTime
+                  << "        " << total / poolTime << std::endl;
+        std::cout << "    reserved " << pool.reservedBytes() / 1024
+                  << " KiB, used " << pool.usedBytes()
+                  << " bytes, cached " << pool.freeListBytes() / 1024
+                  << " KiB" << std::endl;
+        ok = check(pool.usedBytes() == 0, "every block given back") && ok;
+
+        if (threads < cores && threads*2 > cores)
+            threads = cores / 2;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Ksl/PoolAllocator.h>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <unordered_map>
+
+#include "bench.h"
+
+using namespace Ksl;
+
+// Builds a map of `size` random keys, then destroys it. The
+// time includes giving the nodes back. The sum of the keys
+// times the values goes in checksum
+template <typename Map>
+static double build(int size, Map map, uint64_t *checksum) {
+    uint32_t state = 42;
+    auto start = std::chrono::steady_clock::now();
+    {
+        Map built(std::move(map));
+        for (int k=0; k<size; ++k) {
+            uint32_t key = xorshift(state);
+            built[key] += k;
+        }
+        *checksum = 0;
+        for (const auto &node : built)
+            *checksum += uint64_t(node.first) * uint64_t(node.second);
+    }
+    return seconds(start);
+}
+
+
+int main(int argc, char *argv[]) {
+    const int size = argc > 1 ? std::atoi(argv[1]) : 2000000;
+    const int rounds = argc > 2 ? std::atoi(argv[2]) : 3;
+
+    typedef std::pair<const uint32_t,int> Node;
+    typedef std::unordered_map<uint32_t,int> Hash;
+    typedef std::unordered_map<uint32_t,int,std::hash<uint32_t>,
+                               std::equal_to<uint32_t>,PoolAllocator<Node>> PoolHash;
+    typedef std::map<uint32_t,int> Tree;
+    typedef std::map<uint32_t,int,std::less<uint32_t>,PoolAllocator<Node>> PoolTree;
+
+    std::cout << size << " keys, best of " << rounds << " rounds" << std::endl;
+
+    // the pool is kept between rounds, so that the later
+    // ones build on the freed nodes of the first
+    MemoryPool pool(1 << 20, 64);
+    PoolAllocator<Node> alloc(&pool);
+
+    double hashTime = 1e9, poolHashTime = 1e9;
+    double treeTime = 1e9, poolTreeTime = 1e9;
+    uint64_t expected, sum;
+    bool ok = true;
+    for (int r=0; r<rounds; ++r) {
+        hashTime = std::min(hashTime, build(size, Hash(), &expected));
+        poolHashTime = std::min(poolHashTime, build(size, PoolHash(0, std::hash<uint32_t>(),
+                                                                   std::equal_to<uint32_t>(), alloc), &sum));
+        ok = check(sum == expected, "unordered_map with PoolAllocator") && ok;
+        treeTime = std::min(treeTime, build(size, Tree(), &sum));
+        ok = check(sum == expected, "map") && ok;
+        poolTreeTime = std::min(poolTreeTime, build(size, PoolTree(std::less<uint32_t>(), alloc), &sum));
+        ok = check(sum == expected, "map with PoolAllocator") && ok;
+    }
+
+    std::cout << "unordered_map  std::allocator " << hashTime << " s, PoolAllocator "
+              << poolHashTime << " s (" << hashTime / poolHashTime << "x)" << std::endl;
+    std::cout << "map            std::allocator " << treeTime << " s, PoolAllocator "
+              << poolTreeTime << " s (" << treeTime / poolTreeTime << "x)" << std::endl;
+    std::cout << "MemoryPool reserved " << pool.reservedBytes() / 1024
+              << " KiB, in free lists " << pool.freeListBytes() / 1024 << " KiB" << std::endl;
+
+#if __cplusplus >= 201703L
+    PoolResource resource(&pool);
+    double pmrTime = 1e9;
+    for (int r=0; r<rounds; ++r) {
+        pmrTime = std::min(pmrTime, build(size, std::pmr::unordered_map<uint32_t,int>(&resource), &sum));
+        ok = check(sum == expected, "pmr::unordered_map") && ok;
+    }
+    std::cout << "pmr::unordered_map PoolResource " << pmrTime << " s ("
+              << hashTime / pmrTime << "x)" << std::endl;
+#endif
+    ok = check(pool.usedBytes() == 0, "every node given back") && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2016  Elvis Teixeira
+ *
+ * This source code is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This source code is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Ksl/ShortestPath.h>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <vector>
+
+#include "bench.h"
+
+using namespace Ksl;
+
+// A directed graph in compressed sparse row layout
+struct Csr {
+    uint32_t count;
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> targets;
+    std::vector<double> weights;
+};
+
+
+// Random graph where one vertex in eight has many edges. The
+// last vertices are never targets, so they are not reached.
+// Weights are whole numbers, so that every order of summing
+// them gives the same distances
+static Csr randomGraph(uint32_t count) {
+    const uint32_t unreached = 16;
+    Csr csr;
+    csr.count = count;
+    csr.offsets.reserve(count + 1);
+    uint64_t state = 88172645463325252ull;
+    for (uint32_t v=0; v<count; ++v) {
+        csr.offsets.push_back(csr.targets.size());
+        const int degree = (v % 8 == 0) ? 24 : 3;
+        for (int k=0; k<degree; ++k) {
+            csr.targets.push_back(uint32_t(xorshift(state) % (count - unreached)));
+            csr.weights.push_back(double(xorshift(state) % 1000));
+        }
+    }
+    csr.offsets.push_back(csr.targets.size());
+    return csr;
+}
+
+
+// Dijkstra's algorithm with a binary heap of the standard
+// library, to check against
+static std::vector<double> reference(const Csr &csr, uint32_t source) {
+    typedef std::pair<double,uint32_t> Entry;
+    std::vector<double> distances(csr.count, std::numeric_limits<double>::infinity());
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+    distances[source] = 0.0;
+    heap.push(Entry(0.0, source));
+    while (!heap.empty()) {
+        const Entry top = heap.top();
+        heap.pop();
+        const uint32_t u = top.second;
+        if (top.first > distances[u])
+            continue;
+        for (uint64_t e=csr.offsets[u]; e<csr.offsets[u+1]; ++e) {
+            const double distance = top.first + csr.weights[e];
+            if (distance < distances[csr.targets[e]]) {
+                distances[csr.targets[e]] = distance;
+                heap.push(Entry(distance, csr.targets[e]));
+            }
+        }
+    }
+    return distances;
+}
+
+
+// The lightest edge from u to v, infinite if there is none
+static double weight(const Csr &csr, uint32_t u, uint32_t v) {
+    double best = std::numeric_limits<double>::infinity();
+    for (uint64_t e=csr.offsets[u]; e<csr.offsets[u+1]; ++e) {
+        if (csr.targets[e] == v)
+            best = std::min(best, csr.weights[e]);
+    }
+    return best;
+}
+
+
+// A path from source to target whose weights add up to distance
+static bool isPath(const Csr &csr, const Array<1,int> &path,
+                   uint32_t source, uint32_t target, double distance)
+{
+    if (std::isinf(distance))
+        return path.size() == 0;
+    if (path.size() == 0 || path[0] != int(source) || path[path.size()-1] != int(target))
+        return false;
+    double sum = 0.0;
+    for (int k=0; k+1<path.size(); ++k)
+        sum += weight(csr, uint32_t(path[k]), uint32_t(path[k+1]));
+    return sum == distance;
+}
+
+
+int main(int argc, char *argv[]) {
+    const uint32_t count = argc > 1 ? uint32_t(std::atoi(argv[1])) : 1000000;
+    const uint32_t source = 0;
+    if (count < 64) {
+        std::cout << "at least 64 vertices" << std::endl;
+        return 1;
+    }
+
+    Csr csr = randomGraph(count);
+    std::cout << count << " vertices, " << csr.targets.size() << " edges" << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<double> expected = reference(csr, source);
+    double referenceTime = seconds(start);
+    std::cout << "std::priority_queue        " << referenceTime << " s" << std::endl;
+
+    ShortestPath paths;
+    bool ok = check(paths.setGraph(count, csr.offsets.data(), csr.targets.data(),
+                                   csr.weights.data()), "setGraph");
+
+    struct Setup { const char *name; ShortestPath::Method method; bool parallel; double delta; };
+    const Setup setups[] = {
+        { "Dijkstra                   ", ShortestPath::Dijkstra, false, 0.0 },
+        { "RadixDijkstra              ", ShortestPath::RadixDijkstra, false, 0.0 },
+        { "DeltaStepping              ", ShortestPath::DeltaStepping, false, 0.0 },
+        { "DeltaStepping parallel     ", ShortestPath::DeltaStepping, true, 0.0 },
+        { "DeltaStepping narrow       ", ShortestPath::DeltaStepping, true, 7.0 }
+    };
+    for (const Setup &setup : setups) {
+        paths.setMethod(setup.method);
+        paths.setParallel(setup.parallel);
+        paths.setDelta(setup.delta);
+        start = std::chrono::steady_clock::now();
+        paths.run(source);
+        double time = seconds(start);
+
+        // the parent of each vertex is the end of an edge
+        // that gives its distance
+        Array<1> distances = paths.distances();
+        Array<1,int> parents = paths.parents();
+        bool right = parents[int(source)] == -1;
+        for (uint32_t v=0; v<count; ++v) {
+            right = right && distances[int(v)] == expected[v];
+            const int parent = parents[int(v)];
+            if (v != source && !std::isinf(expected[v])) {
+                right = right && parent >= 0
+                    && distances[parent] + weight(csr, uint32_t(parent), v) == distances[int(v)];
+            }
+            else if (v != source) {
+                right = right && parent == -1;
+            }
+        }
+        for (uint32_t v=count-4; v<count; ++v)
+            right = right && isPath(csr, paths.path(v), source, v, expected[v]);
+        ok = check(right, setup.name) && ok;
+        std::cout << setup.name << time << " s (" << referenceTime / time << "x)"
+                  << (right ? "" : ", WRONG DISTANCES") << std::endl;
+    }
+
+    // point to point, from both ends
+    bool right = true;
+    uint64_t state = 42;
+    start = std::chrono::steady_clock::now();
+    const int queries = 100;
+    for (int q=0; q<queries; ++q) {
+        const uint32_t target = (q < 4) ? count - 1 - q : uint32_t(xorshift(state) % count);
+        Array<1,int> path;
+        const double distance = paths.distance(source, target, &path);
+        right = right && (distance == expected[target]
+                          || (std::isinf(distance) && std::isinf(expected[target])));
+        right = right && isPath(csr, path, source, target, expected[target]);
+    }
+    ok = check(right, "bidirectional distance") && ok;
+    std::cout << "bidirectional              " << seconds(start) / queries
+              << " s per query" << (right ? "" : ", WRONG DISTANCES") << std::endl;
+
+    // negative weights are refused
+    csr.weights[count / 2] = -1.0;
+    ok = check(!paths.setGraph(count, csr.offsets.data(), csr.targets.data(),
+                               csr.weights.data()), "negative weight refused") && ok;
+    return ok ? 0 : 1;
+}